@@ -89,9 +89,12 @@ namespace ace {
          */
         bool AutoResetEvent::WaitOne(uint32_t milliseconds){
             std::unique_lock<std::mutex>lock(mutex_);
+            // a Set made before the wait began is still pending, keep it
+            if (!signal_.wait_for(lock, std::chrono::milliseconds(milliseconds),
+                    [this](){return flag_ == true;}))
+                return false;
             flag_ = false;
-            return signal_.wait_for(lock, std::chrono::milliseconds(milliseconds), 
-                    [this](){return flag_ == true;});
+            return true;
         }
         
     } // namespace system
@@ -26,10 +26,13 @@
  */
 #include "include/Autohub.hpp"
 #include "include/HouseLincServer.hpp"
+#include "include/TapServer.hpp"
 #include "include/insteon/InsteonNetwork.hpp"
+#include "include/insteon/InsteonMessage.hpp"
 #include "include/autoapi.hpp"
 #include "include/DynamicLibrary.hpp"
 #include "include/Logger.h"
+#include "include/system/HandlerProfiler.hpp"
 
 #include "include/json/json.h"
 #include "include/json/json-forwards.h"
@@ -37,19 +40,62 @@
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 namespace ace
 {
 
+namespace
+{
+
+Json::Value
+poolStatistics(const system::ThreadPoolStats& stats) {
+    Json::Value pool;
+    pool["name"] = stats.name;
+    pool["threads"] = Json::UInt64(stats.threads);
+    pool["posted"] = Json::UInt64(stats.posted);
+    pool["executed"] = Json::UInt64(stats.executed);
+    pool["latency_us"] = Json::UInt64(stats.latency_us);
+    pool["max_latency_us"] = Json::UInt64(stats.max_latency_us);
+    return pool;
+}
+}
+
 // TODO verify YAML::Node prior to passing to InsteonNetwork constructor
 
-Autohub::Autohub(boost::asio::io_service& io_service, YAML::Node root)
-: io_service_(io_service), strand_hub_(io_service), root_node_(root),
-insteon_network_(new insteon::InsteonNetwork(io_service, root["INSTEON"])),
-wspp_next_id_(0) {
+Autohub::Autohub(system::ThreadPool& dispatch_pool,
+        system::ThreadPool& plm_pool, YAML::Node root)
+: dispatch_pool_(dispatch_pool), plm_pool_(plm_pool),
+io_service_(dispatch_pool.io_service()), strand_hub_(io_service_),
+root_node_(root), insteon_network_(new insteon::InsteonNetwork(io_service_,
+plm_pool.io_service(), root["INSTEON"])),
+wspp_pool_("websocket", root["WEBSOCKET"]["threads"].as<std::size_t>(2),
+root["THREADS"]["websocket_affinity"].as<std::vector<int>>(
+std::vector<int>())), wspp_io_service_(wspp_pool_.io_service()),
+wspp_next_id_(1), wspp_flush_timer_(wspp_io_service_), wspp_flush_scheduled_(false),
+wspp_total_coalesced_(0), wspp_total_dropped_(0) {
     /*if (root_node_["INSTEON"].IsNull() || !root_node_["INSTEON"].IsDefined())
         throw; // TODO remove throw and improve error handling
      */
+    YAML::Node websocket = root_node_["WEBSOCKET"];
+    wspp_max_buffered_ = websocket["max_buffered_bytes"].as<std::size_t>(65536);
+    wspp_max_pending_ = websocket["max_pending_updates"].as<std::size_t>(256);
+
+    std::string policy = websocket["slow_client_policy"]
+            .as<std::string>("coalesce");
+    std::transform(policy.begin(), policy.end(), policy.begin(), ::tolower);
+    wspp_slow_client_policy_ = policy.compare("disconnect") == 0 ?
+            SlowClientPolicy::Disconnect : SlowClientPolicy::Coalesce;
+
+    YAML::Node houselinc = root_node_["HOUSELINC"];
+    houselinc_port_ = houselinc["listening_port"].as<int>(9761);
+    houselinc_max_clients_ = houselinc["max_clients"].as<std::size_t>(0);
+    houselinc_idle_timeout_ = std::chrono::seconds(
+            houselinc["idle_timeout"].as<int>(0));
+
+    YAML::Node tap = root_node_["TAP"];
+    tap_port_ = tap["listening_port"].as<int>(0);
+    tap_max_clients_ = tap["max_clients"].as<std::size_t>(0);
 }
 
 Autohub::~Autohub() {
@@ -68,20 +114,31 @@ Autohub::wsppOnOpen(connection_hdl hdl) {
             u->get_resource().c_str());
 
     connection_data data;
-    data.session_id = wspp_next_id_++;
     data.name = "";
     data.authenticated = false;
+    data.messages_sent = 0;
+    data.messages_coalesced = 0;
+    data.messages_dropped = 0;
 
     std::lock_guard<std::mutex>lock(wspp_connections_mutex_);
+    data.session_id = wspp_next_id_++;
     wspp_connections_[hdl] = data;
 }
 
 void
 Autohub::wsppOnClose(connection_hdl hdl) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
-    connection_data& data = get_data_from_hdl(hdl);
     std::lock_guard<std::mutex>lock(wspp_connections_mutex_);
-    wspp_connections_.erase(hdl);
+    auto it = wspp_connections_.find(hdl);
+    if (it == wspp_connections_.end())
+        return;
+    utils::Logger::Instance().Info("wspp session %d closed\n"
+            "\t  - sent: %llu coalesced: %llu dropped: %llu",
+            it->second.session_id,
+            (unsigned long long) it->second.messages_sent,
+            (unsigned long long) it->second.messages_coalesced,
+            (unsigned long long) it->second.messages_dropped);
+    wspp_connections_.erase(it);
 }
 
 void
@@ -96,18 +153,25 @@ Autohub::wsppOnMessage(connection_hdl hdl,
     } else {
 
     }
-    std::stringstream ss;
-    ss.str(msg->get_payload());
+    const std::string& payload = msg->get_payload();
 
+    // one reader per websocket thread, parse straight from the payload
+    static thread_local std::unique_ptr<Json::CharReader> reader(
+            Json::CharReaderBuilder().newCharReader());
     Json::Value root;
-    Json::Reader reader;
-    reader.parse(ss.str(), root);
+    std::string errors;
+    if (!reader->parse(payload.data(), payload.data() + payload.size(),
+            &root, &errors)) {
+        utils::Logger::Instance().Warning("%s\n\t  - invalid json from "
+                "session %d: %s", FUNCTION_NAME_CSTR, data.session_id,
+                errors.c_str());
+        return;
+    }
 
     std::string event;
     event = root.get("event", "").asString();
 
-    utils::Logger::Instance().Info("wspp received: %s",
-            root.toStyledString().c_str());
+    utils::Logger::Instance().Debug("wspp received: %s", payload.c_str());
 
     if (event.compare("getDeviceList") == 0) {
         Json::Value root;
@@ -115,9 +179,117 @@ Autohub::wsppOnMessage(connection_hdl hdl,
         utils::Logger::Instance().Info(root.toStyledString().c_str());
         msg->set_payload(root.toStyledString());
         wspp_server_.send(hdl, msg);
+    } else if (event.compare("getStatistics") == 0) {
+        Json::Value root = wsppStatistics();
+        msg->set_payload(root.toStyledString());
+        wspp_server_.send(hdl, msg);
+    } else if (event.compare("getHouseLincSessions") == 0) {
+        Json::Value root = houselincStatistics();
+        msg->set_payload(root.toStyledString());
+        wspp_server_.send(hdl, msg);
+    } else if (event.compare("getHandlerStats") == 0) {
+        const Json::Value& count = root.get("count", 10);
+        const Json::Value& reset = root.get("reset", false);
+        Json::Value reply;
+        if (count.isUInt() && reset.isBool()) {
+            reply = handlerStatistics(count.asUInt(), reset.asBool());
+        } else {
+            reply["event"] = "handlerStats";
+            reply["error"] = "count must be an unsigned integer and reset "
+                    "a boolean";
+        }
+        msg->set_payload(reply.toStyledString());
+        wspp_server_.send(hdl, msg);
     } else if (event.compare("device") == 0) {
-        strand_hub_.post(std::bind(&type::internalReceiveCommand, this,
-                ss.str()));
+        insteon::InsteonCommand command;
+        std::string error;
+        if (!parseCommand(root, command, error)) {
+            utils::Logger::Instance().Warning("%s\n\t  - %s",
+                    FUNCTION_NAME_CSTR, error.c_str());
+            if (command.request_id.empty())
+                return;
+            Json::Value reply;
+            reply["event"] = "commandResult";
+            reply["request_id"] = command.request_id;
+            reply["status"] = insteon::to_string(
+                    insteon::InsteonCommandStatus::Invalid);
+            reply["error"] = error;
+            wspp_server_.send(hdl, reply.toStyledString(),
+                    websocketpp::frame::opcode::text);
+            return;
+        }
+        command.session_id = data.session_id;
+        // plugins still receive the raw json, only copy it when one is loaded
+        std::string json = dynamicLibraryMap_.empty() ? std::string() : payload;
+        strand_hub_.post(system::profile("Autohub::internalReceiveCommand",
+                [this, json = std::move(json), command = std::move(command)]()
+                mutable {
+            internalReceiveCommand(std::move(json), std::move(command));
+        }));
+    } else if (event.compare("batch") == 0) {
+        insteon::InsteonCommandBatch batch;
+        std::string error;
+        Json::Value reply;
+        if (parseBatch(root, batch, error)) {
+            batch.session_id = data.session_id;
+            reply["event"] = "batchAccepted";
+            reply["count"] = Json::UInt64(batch.commands.size());
+            if (!batch.request_id.empty())
+                reply["request_id"] = batch.request_id;
+            std::string json = dynamicLibraryMap_.empty() ? std::string() :
+                    payload;
+            strand_hub_.post(system::profile("Autohub::internalReceiveBatch",
+                    [this, json = std::move(json), batch = std::move(batch)]()
+                    mutable {
+                internalReceiveBatch(std::move(json), std::move(batch));
+            }));
+        } else {
+            reply["event"] = "batchRejected";
+            reply["error"] = error;
+        }
+        wspp_server_.send(hdl, reply.toStyledString(),
+                websocketpp::frame::opcode::text);
+    } else if (event.compare("provisionGroup") == 0) {
+        std::vector<uint32_t> devices;
+        std::string error;
+        for (const auto& it : root["devices"]) {
+            uint32_t address = 0;
+            if (it.isUInt()) {
+                address = it.asUInt();
+            } else if (it.isString()) {
+                try {
+                    address = std::stoul(it.asString(), nullptr, 0);
+                } catch (const std::exception&) {
+                    address = 0;
+                }
+            }
+            if (address == 0 || address > 0xFFFFFF) {
+                error = "devices must be insteon addresses";
+                break;
+            }
+            devices.push_back(address);
+        }
+        const Json::Value& group = root.get("group", -1);
+        const Json::Value& id = root.get("request_id", "");
+        std::string request_id = id.isString() ? id.asString() : "";
+        if (!root["devices"].isArray() || !group.isInt() || !id.isString()) {
+            error = "devices must be an array, group an integer and "
+                    "request_id a string";
+        } else if (error.empty() && devices.size() < 2) {
+            error = "a group requires at least two devices";
+        }
+        if (!error.empty()) {
+            Json::Value reply;
+            reply["event"] = "groupProvisioned";
+            if (!request_id.empty())
+                reply["request_id"] = request_id;
+            reply["error"] = error;
+            wspp_server_.send(hdl, reply.toStyledString(),
+                    websocketpp::frame::opcode::text);
+            return;
+        }
+        insteon_network_->provisionGroup(std::move(devices), group.asInt(),
+                std::move(request_id), data.session_id);
     }
     //TestPlugin();
 }
@@ -138,29 +310,446 @@ Autohub::burp(std::string burp) {
 }
 
 void
-Autohub::internalReceiveCommand(const std::string json) {
+Autohub::internalReceiveCommand(std::string json,
+        insteon::InsteonCommand command) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
     for (const auto& it : dynamicLibraryMap_) {
         std::shared_ptr<DynamicLibrary> ptr = it.second;
         if (ptr) {
-            io_service_.post(std::bind(&AutoAPI::InternalReceiveCommand,
+            wspp_pool_.post("AutoAPI::InternalReceiveCommand",
+                    std::bind(&AutoAPI::InternalReceiveCommand,
                     ptr->get_object(), json));
         }
     }
-    insteon_network_->internalReceiveCommand(json);
+    insteon_network_->internalReceiveCommand(std::move(command));
+}
+
+void
+Autohub::internalReceiveBatch(std::string json,
+        insteon::InsteonCommandBatch batch) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    for (const auto& it : dynamicLibraryMap_) {
+        std::shared_ptr<DynamicLibrary> ptr = it.second;
+        if (ptr) {
+            wspp_pool_.post("AutoAPI::InternalReceiveCommand",
+                    std::bind(&AutoAPI::InternalReceiveCommand,
+                    ptr->get_object(), json));
+        }
+    }
+    insteon_network_->internalReceiveBatch(std::move(batch));
+}
+
+/**
+ * ParseBatch
+ * 
+ * Validates a batch event once, at the edge.
+ * {
+ *    "event" : "batch",
+ *    "request_id" : "scene-42",
+ *    "ordered" : false,
+ *    "commands" : [
+ *       { "device_id" : 2547435, "command" : "on", "command_two" : 255 },
+ *       { "device_id" : 2548930, "command" : "off" }
+ *    ]
+ * }
+ * 
+ * @param root parsed event
+ * @param batch receives the validated commands
+ * @param error receives the reason the batch was rejected
+ * @return false if the batch is malformed
+ */
+bool
+Autohub::parseBatch(const Json::Value& root,
+        insteon::InsteonCommandBatch& batch, std::string& error) {
+    const Json::Value& commands = root["commands"];
+    if (!commands.isArray() || commands.empty()) {
+        error = "commands must be a non empty array";
+        return false;
+    }
+    batch.ordered = root.get("ordered", false).asBool();
+    if (root.isMember("request_id") && !root["request_id"].isNull())
+        batch.request_id = root["request_id"].asString();
+    batch.commands.reserve(commands.size());
+    for (const auto& it : commands) {
+        insteon::InsteonCommand command;
+        if (!parseCommand(it, command, error))
+            return false;
+        batch.commands.push_back(std::move(command));
+    }
+    return true;
+}
+
+/**
+ * ParseCommand
+ * 
+ * Converts a device command into its typed form, once, at the edge.
+ * {
+ *    "event" : "device",
+ *    "request_id" : "lamp-1",
+ *    "device_id" : 2547435,
+ *    "command" : "on",
+ *    "command_two" : 255
+ * }
+ * device_id may be a number or a string, ie: "2547435" or "0x26DEEB".
+ * 
+ * @param root parsed command
+ * @param command receives the typed command
+ * @param error receives the reason the command was rejected
+ * @return false if the command is malformed
+ */
+bool
+Autohub::parseCommand(const Json::Value& root,
+        insteon::InsteonCommand& command, std::string& error) {
+    if (root.isMember("request_id") && !root["request_id"].isNull())
+        command.request_id = root["request_id"].asString();
+    const Json::Value& device_id = root["device_id"];
+    uint32_t address = 0;
+    if (device_id.isIntegral()) {
+        address = device_id.asUInt();
+    } else if (device_id.isString()) {
+        try {
+            address = std::stoul(device_id.asString(), nullptr, 0);
+        } catch (const std::exception&) {
+            address = 0;
+        }
+    }
+    command.command = root.get("command", "").asString();
+    if (address == 0 || command.command.empty()) {
+        error = "each command requires device_id and command";
+        return false;
+    }
+    command.device_id = address;
+    int command_two = root.get("command_two", 0).asInt();
+    command.command_two = command_two <= 0 ? 0x00 :
+            command_two >= 255 ? 0xFF : command_two;
+    return true;
 }
 
 void
 Autohub::onUpdateDevice(Json::Value json) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
     json["event"] = "deviceUpdate";
+    uint32_t device_id = json.get("device_address_", 0).asUInt();
+    // serialize once, every client receives the same payload
+    std::shared_ptr<std::string> payload = std::make_shared<std::string>(
+            json.toStyledString());
+    // hand off to the websocket threads, a slow client never blocks the PLM
+    wspp_pool_.post("Autohub::onUpdateDevice", [this, device_id, payload]{
+        std::lock_guard<std::mutex>lock(wspp_connections_mutex_);
+        for (auto& it : wspp_connections_) {
+            wsppSendUpdate(it.first, it.second, device_id, *payload);
+        }
+    });
+}
+
+/**
+ * onSyncProgress
+ * 
+ * Publishes startup sync progress to every client. Progress events share
+ * the coalescing slot zero, a slow client only receives the latest one.
+ * 
+ * @param json the syncProgress event
+ */
+void
+Autohub::onSyncProgress(Json::Value json) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    std::shared_ptr<std::string> payload = std::make_shared<std::string>(
+            json.toStyledString());
+    wspp_pool_.post("Autohub::onSyncProgress", [this, payload]{
+        std::lock_guard<std::mutex>lock(wspp_connections_mutex_);
+        for (auto& it : wspp_connections_) {
+            wsppSendUpdate(it.first, it.second, 0, *payload);
+        }
+    });
+}
+
+/**
+ * onGroupSuggestion
+ * 
+ * Offers every client to provision a PLM group. Suggestions are rare and
+ * each names a different set, they are sent as is and never coalesced.
+ * 
+ * @param json the groupSuggestion event
+ */
+void
+Autohub::onGroupSuggestion(Json::Value json) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    std::shared_ptr<std::string> payload = std::make_shared<std::string>(
+            json.toStyledString());
+    wspp_pool_.post("Autohub::onGroupSuggestion", [this, payload]{
+        std::lock_guard<std::mutex>lock(wspp_connections_mutex_);
+        for (auto& it : wspp_connections_) {
+            websocketpp::lib::error_code ec;
+            wspp_server_.send(it.first, *payload,
+                    websocketpp::frame::opcode::text, ec);
+            if (!ec)
+                it.second.messages_sent++;
+        }
+    });
+}
+
+/**
+ * onCommandResult
+ * 
+ * Sends the outcome of a command carrying a request_id to the session which
+ * sent it. Results are never coalesced, the session may have closed since.
+ * 
+ * @param session_id the originating session, 0 for none
+ * @param json the commandResult event
+ */
+void
+Autohub::onCommandResult(uint32_t session_id, Json::Value json) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    if (session_id == 0)
+        return; // a plugin or raw command, no client to answer
+    std::shared_ptr<std::string> payload = std::make_shared<std::string>(
+            json.toStyledString());
+    wspp_pool_.post("Autohub::onCommandResult", [this, session_id, payload]{
+        std::lock_guard<std::mutex>lock(wspp_connections_mutex_);
+        for (auto& it : wspp_connections_) {
+            if (it.second.session_id != session_id)
+                continue;
+            websocketpp::lib::error_code ec;
+            wspp_server_.send(it.first, *payload,
+                    websocketpp::frame::opcode::text, ec);
+            if (!ec)
+                it.second.messages_sent++;
+            return;
+        }
+    });
+}
+
+/**
+ * wsppSendUpdate
+ * 
+ * Sends a device update to a single client, honoring the outbound queue
+ * limit. A client with more than max_buffered_bytes waiting in its queue is
+ * either disconnected or has its updates coalesced, keeping only the latest
+ * update per device until the queue drains.
+ * 
+ * Must be called with wspp_connections_mutex_ held.
+ * 
+ * @param hdl websocket connection handle
+ * @param data session data of the connection
+ * @param device_id the device the update belongs to
+ * @param payload serialized update
+ */
+void
+Autohub::wsppSendUpdate(connection_hdl hdl, connection_data& data,
+        uint32_t device_id, const std::string& payload) {
+    websocketpp::lib::error_code ec;
+    wspp_server::connection_ptr con = wspp_server_.get_con_from_hdl(hdl, ec);
+    if (ec || !con)
+        return;
+
+    if (data.pending_updates.empty() &&
+            con->get_buffered_amount() < wspp_max_buffered_) {
+        wspp_server_.send(hdl, payload, websocketpp::frame::opcode::text, ec);
+        if (!ec)
+            data.messages_sent++;
+        return;
+    }
+
+    if (wspp_slow_client_policy_ == SlowClientPolicy::Disconnect) {
+        utils::Logger::Instance().Warning("%s\n\t  - session %d exceeded %zu "
+                "buffered bytes, disconnecting", FUNCTION_NAME_CSTR,
+                data.session_id, wspp_max_buffered_);
+        data.messages_dropped++;
+        wspp_total_dropped_++;
+        con->close(websocketpp::close::status::policy_violation,
+                "Outbound queue limit exceeded", ec);
+        return;
+    }
+
+    auto it = data.pending_updates.find(device_id);
+    if (it != data.pending_updates.end()) {
+        it->second = payload;
+        data.messages_coalesced++;
+        wspp_total_coalesced_++;
+    } else if (data.pending_updates.size() < wspp_max_pending_) {
+        data.pending_updates[device_id] = payload;
+    } else {
+        data.messages_dropped++;
+        wspp_total_dropped_++;
+    }
+    wsppScheduleFlush();
+}
+
+/**
+ * Arms the flush timer if it isn't already running.
+ * Must be called with wspp_connections_mutex_ held.
+ */
+void
+Autohub::wsppScheduleFlush() {
+    if (wspp_flush_scheduled_)
+        return;
+    wspp_flush_scheduled_ = true;
+    wspp_flush_timer_.expires_from_now(std::chrono::milliseconds(
+            root_node_["WEBSOCKET"]["flush_interval"].as<int>(250)));
+    wspp_flush_timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted)
+            return;
+        wsppFlushPending();
+    });
+}
+
+/**
+ * Delivers coalesced updates to clients whose outbound queue has drained.
+ */
+void
+Autohub::wsppFlushPending() {
+    std::lock_guard<std::mutex>lock(wspp_connections_mutex_);
+    wspp_flush_scheduled_ = false;
+    bool still_pending = false;
+    for (auto& it : wspp_connections_) {
+        connection_data& data = it.second;
+        if (data.pending_updates.empty())
+            continue;
+        websocketpp::lib::error_code ec;
+        wspp_server::connection_ptr con = wspp_server_.get_con_from_hdl(
+                it.first, ec);
+        if (ec || !con) {
+            data.pending_updates.clear();
+            continue;
+        }
+        if (con->get_buffered_amount() >= wspp_max_buffered_) {
+            still_pending = true;
+            continue;
+        }
+        for (const auto& update : data.pending_updates) {
+            wspp_server_.send(it.first, update.second,
+                    websocketpp::frame::opcode::text, ec);
+            if (!ec)
+                data.messages_sent++;
+        }
+        data.pending_updates.clear();
+    }
+    if (still_pending)
+        wsppScheduleFlush();
+}
+
+/**
+ * Per connection outbound statistics, requested with the getStatistics event
+ */
+Json::Value
+Autohub::wsppStatistics() {
+    Json::Value root;
+    Json::Value connections(Json::arrayValue);
+    std::lock_guard<std::mutex>lock(wspp_connections_mutex_);
     for (const auto& it : wspp_connections_) {
-        io_service_.post([ = ]{
-            wspp_server_.send(it.first, json.toStyledString(),
-            websocketpp::frame::opcode::text);
-        });
+        Json::Value connection;
+        websocketpp::lib::error_code ec;
+        wspp_server::connection_ptr con = wspp_server_.get_con_from_hdl(
+                it.first, ec);
+        connection["session_id"] = it.second.session_id;
+        connection["name"] = it.second.name;
+        connection["messages_sent"] = Json::UInt64(it.second.messages_sent);
+        connection["messages_coalesced"] =
+                Json::UInt64(it.second.messages_coalesced);
+        connection["messages_dropped"] =
+                Json::UInt64(it.second.messages_dropped);
+        connection["pending_updates"] =
+                Json::UInt64(it.second.pending_updates.size());
+        connection["buffered_bytes"] = Json::UInt64(
+                (ec || !con) ? 0 : con->get_buffered_amount());
+        connections.append(connection);
+    }
+    root["connections"] = connections;
+    root["messages_coalesced"] = Json::UInt64(wspp_total_coalesced_);
+    root["messages_dropped"] = Json::UInt64(wspp_total_dropped_);
+    root["threads"] = Json::UInt64(wspp_pool_.stats().threads);
+    Json::Value pools(Json::arrayValue);
+    pools.append(poolStatistics(dispatch_pool_.stats()));
+    pools.append(poolStatistics(plm_pool_.stats()));
+    pools.append(poolStatistics(wspp_pool_.stats()));
+    root["pools"] = pools;
+    root["event"] = "statistics";
+    return root;
+}
 
+/**
+ * Per session raw port statistics, requested with the getHouseLincSessions
+ * event
+ */
+Json::Value
+Autohub::houselincStatistics() {
+    Json::Value root;
+    Json::Value sessions(Json::arrayValue);
+    root["event"] = "houselincSessions";
+    root["listening_port"] = houselinc_port_;
+    root["max_clients"] = Json::UInt64(houselinc_max_clients_);
+    root["idle_timeout"] = Json::Int64(houselinc_idle_timeout_.count());
+    if (!houselinc_server_) {
+        root["sessions"] = sessions;
+        return root;
     }
+    for (const auto& it : houselinc_server_->Stats()) {
+        Json::Value session;
+        session["session_id"] = it.id;
+        session["remote"] = it.remote;
+        session["frames_in"] = Json::UInt64(it.frames_in);
+        session["frames_out"] = Json::UInt64(it.frames_out);
+        session["bytes_in"] = Json::UInt64(it.bytes_in);
+        session["bytes_out"] = Json::UInt64(it.bytes_out);
+        session["idle_ms"] = Json::UInt64(it.idle_ms);
+        sessions.append(session);
+    }
+    root["sessions"] = sessions;
+    root["accepted"] = Json::UInt64(houselinc_server_->accepted());
+    root["rejected"] = Json::UInt64(houselinc_server_->rejected());
+    return root;
+}
+
+/**
+ * Handler types by total execution time, requested with the
+ * getHandlerStats event or GET /handlers
+ * @param count number of handler types, 0 for all
+ * @param reset clear the figures once they are read
+ */
+Json::Value
+Autohub::handlerStatistics(std::size_t count, bool reset) {
+    system::HandlerProfiler& profiler = system::HandlerProfiler::Instance();
+    Json::Value root;
+    Json::Value handlers(Json::arrayValue);
+    root["event"] = "handlerStats";
+    root["enabled"] = profiler.Enabled();
+    root["slow_handler_ms"] = Json::Int64(profiler.SlowThreshold().count());
+    for (const auto& it : profiler.Top(count)) {
+        Json::Value handler;
+        handler["name"] = it.name;
+        handler["count"] = Json::UInt64(it.count);
+        handler["avg_wait_us"] = Json::UInt64(
+                it.count ? it.total_wait_us / it.count : 0);
+        handler["max_wait_us"] = Json::UInt64(it.max_wait_us);
+        handler["avg_exec_us"] = Json::UInt64(
+                it.count ? it.total_exec_us / it.count : 0);
+        handler["max_exec_us"] = Json::UInt64(it.max_exec_us);
+        handler["total_exec_us"] = Json::UInt64(it.total_exec_us);
+        handler["slow"] = Json::UInt64(it.slow);
+        handlers.append(handler);
+    }
+    root["handlers"] = handlers;
+    if (reset)
+        profiler.Reset();
+    return root;
+}
+
+/**
+ * wsppOnHttp
+ * 
+ * Plain HTTP requests on the websocket port, GET /handlers returns the
+ * handler statistics for tools that don't speak websocket.
+ */
+void
+Autohub::wsppOnHttp(connection_hdl hdl) {
+    wspp_server::connection_ptr con = wspp_server_.get_con_from_hdl(hdl);
+    if (con->get_resource() != "/handlers") {
+        con->set_status(websocketpp::http::status_code::not_found);
+        return;
+    }
+    con->set_body(handlerStatistics(0, false).toStyledString());
+    con->append_header("Content-Type", "application/json");
+    con->set_status(websocketpp::http::status_code::ok);
 }
 
 void
@@ -198,16 +787,17 @@ Autohub::stop() {
     wspp_server_.stop_listening();
     {
         std::lock_guard<std::mutex>lock(wspp_connections_mutex_);
+        wspp_flush_timer_.cancel();
         for (const auto& it : wspp_connections_) {
             wspp_server::connection_ptr con = wspp_server_.get_con_from_hdl(it.first);
             con->close(1001, "Server shutting down or restarting!");
         }
     }
 
+    wspp_pool_.release();
     wspp_server_.stop();
-    if (wspp_server_thread_.joinable()) {
-        wspp_server_thread_.join();
-    }
+    wspp_pool_.join();
+    system::HandlerProfiler::Instance().Shutdown();
     dynamicLibraryMap_.clear();
 }
 
@@ -218,7 +808,7 @@ Autohub::start() {
     wspp_server_.clear_access_channels(websocketpp::log::alevel::all);
     wspp_server_.clear_error_channels(websocketpp::log::elevel::all);
 
-    wspp_server_.init_asio(&io_service_);
+    wspp_server_.init_asio(&wspp_io_service_);
 
     wspp_server_.set_open_handler(bind(&Autohub::wsppOnOpen,
             this, std::placeholders::_1));
@@ -230,11 +820,43 @@ Autohub::start() {
             this, std::placeholders::_1,
             std::placeholders::_2));
 
+    wspp_server_.set_http_handler(bind(&Autohub::wsppOnHttp,
+            this, std::placeholders::_1));
+
+    YAML::Node profiler = root_node_["PROFILER"];
+    system::HandlerProfiler::Instance().Configure(
+            profiler["enabled"].as<bool>(false), std::chrono::milliseconds(
+            profiler["slow_handler_ms"].as<int>(100)));
+
     insteon_network_->set_update_handler(bind(&type::onUpdateDevice, this,
             std::placeholders::_1));
 
     insteon_network_->set_houselinc_tx(bind(&type::houselincTx, this,
-            std::placeholders::_1));
+            std::placeholders::_1, std::placeholders::_2));
+
+    insteon_network_->set_command_result_handler(bind(&type::onCommandResult,
+            this, std::placeholders::_1, std::placeholders::_2));
+
+    insteon_network_->set_sync_progress_handler(bind(&type::onSyncProgress,
+            this, std::placeholders::_1));
+
+    insteon_network_->set_group_suggestion_handler(bind(
+            &type::onGroupSuggestion, this, std::placeholders::_1));
+
+    // the tap is up before connect so the startup traffic can be watched,
+    // its sessions are served once the websocket threads run
+    if (tap_port_) {
+        try {
+            tap_server_ = std::make_unique<tap_server>(wspp_io_service_,
+                    tap_port_, tap_max_clients_);
+            insteon_network_->set_tap_handler(bind(&type::onTap, this,
+                    std::placeholders::_1, std::placeholders::_2,
+                    std::placeholders::_3));
+        } catch (std::exception& e) {
+            utils::Logger::Instance().Warning("%s\n\t  - tap disabled: %s",
+                    FUNCTION_NAME_CSTR, e.what());
+        }
+    }
 
     if (!insteon_network_->connect()) {
         utils::Logger::Instance().Info("Unable to connect to PLM.\n"
@@ -251,39 +873,137 @@ Autohub::start() {
             std::cout << e.what() << std::endl;
         }
 
-        wspp_server_thread_ = std::move(std::thread(
-                std::bind(&wspp_server::run,
-                &wspp_server_)));
+        // messages from clients are handed to strand_hub_ on the dispatch
+        // pool, updates are handed back with wspp_pool_.post
+        wspp_pool_.start();
 
-        houselinc_server_ = std::make_unique<server>(io_service_, 9761,
-                bind(&type::houselincRx, this, std::placeholders::_1));
+        houselinc_server_ = std::make_unique<server>(io_service_,
+                houselinc_port_, houselinc_max_clients_,
+                houselinc_idle_timeout_, bind(&type::houselincRx, this,
+                std::placeholders::_1, std::placeholders::_2));
 
         TestPlugin();
     }
     return true;
 }
 
+/**
+ * houselincRx
+ * 
+ * Forwards the complete commands of one HouseLinc read to the network,
+ * in order, with a single hop through the hub strand.
+ * 
+ * @param session_id the HouseLinc session the commands came from
+ * @param frames commands without their STX
+ */
 void
-Autohub::houselincRx(std::vector<uint8_t> buffer) {
+Autohub::houselincRx(uint32_t session_id,
+        std::vector<std::vector<uint8_t>> frames) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
     std::ostringstream oss;
-    oss << "The following message was received by the network\n";
-    oss << "\t  - {0x" << utils::ByteArrayToStringStream(
-            buffer, 0, buffer.size()) << "}\n";
+    oss << "The following messages were received from HouseLinc session "
+            << session_id << "\n";
+    for (const auto& frame : frames)
+        oss << "\t  - {0x" << utils::ByteArrayToStringStream(
+            frame, 0, frame.size()) << "}\n";
     utils::Logger::Instance().Debug(oss.str().c_str());
-    strand_hub_.post(std::bind([this, buffer]() {
-        insteon_network_->internalRawCommand(buffer);
+    strand_hub_.post(system::profile("Autohub::houselincRx",
+            [this, session_id, frames = std::move(frames)]() mutable {
+        for (auto& frame : frames)
+            insteon_network_->internalRawCommand(session_id,
+                std::move(frame));
     }));
 }
 
+/**
+ * onTap
+ * 
+ * Called inline for every frame on the serial link. Nothing is done unless
+ * a tap client is connected, then the frame is copied and formatted on a
+ * websocket thread so the PLM path only pays for the copy.
+ * 
+ * @param direction
+ * @param raw the frame with its STX
+ * @param decoded the parsed message, null for frames sent to the IM
+ */
+void
+Autohub::onTap(insteon::TapDirection direction,
+        const std::vector<uint8_t>& raw,
+        const std::shared_ptr<insteon::InsteonMessage>& decoded) {
+    if (!tap_server_->subscribed())
+        return;
+    int64_t timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    // the message is still being handled elsewhere, take a copy
+    insteon::PropertyKeys properties;
+    uint32_t message_id = raw.size() > 1 ? raw[1] : 0;
+    uint32_t origin = 0;
+    if (decoded) {
+        properties = decoded->properties_;
+        message_id = decoded->message_id_;
+        origin = decoded->origin_;
+    }
+    wspp_pool_.post("Autohub::onTap", [this, timestamp, direction, raw,
+            message_id, origin, properties = std::move(properties)]() {
+        static thread_local std::unique_ptr<Json::StreamWriter> writer([]() {
+            Json::StreamWriterBuilder builder;
+            builder["indentation"] = "";
+            return builder.newStreamWriter();
+        }());
+        uint32_t from_address = 0;
+        uint32_t to_address = 0;
+        Json::Value root;
+        root["ts"] = Json::Int64(timestamp);
+        root["dir"] = direction == insteon::TapDirection::Tx ? "tx" :
+                direction == insteon::TapDirection::Echo ? "echo" : "rx";
+        root["raw"] = utils::ByteArrayToStringStream(raw, 0, raw.size());
+        root["message_id"] = message_id;
+        if (origin)
+            root["origin"] = origin;
+        if (direction == insteon::TapDirection::Tx || properties.empty()) {
+            // a 0x62 names its device right after the command byte
+            if (raw.size() > 4 && raw[1] == 0x62)
+                to_address = raw[2] << 16 | raw[3] << 8 | raw[4];
+        } else {
+            Json::Value decoded;
+            for (const auto& it : properties)
+                decoded[it.first] = it.second;
+            root["properties"] = decoded;
+            auto it = properties.find("from_address");
+            if (it != properties.end())
+                from_address = it->second;
+            it = properties.find("to_address");
+            if (it != properties.end())
+                to_address = it->second;
+        }
+        std::ostringstream oss;
+        writer->write(root, &oss);
+        oss << '\n';
+        tap_server_->Publish(std::make_shared<const std::string>(oss.str()),
+                from_address, to_address);
+    });
+}
+
+/**
+ * houselincTx
+ * 
+ * Relays an IM message to HouseLinc. The message is copied once into a
+ * shared buffer which all sessions write from.
+ * 
+ * @param session_id the session to relay to, 0 for every session
+ * @param buffer
+ */
 void
-Autohub::houselincTx(std::vector<uint8_t> buffer) {
+Autohub::houselincTx(uint32_t session_id, const std::vector<uint8_t>& buffer) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
     std::ostringstream oss;
     oss << "Writing the following command to the Network!\n";
     oss << "\t  - {0x" << utils::ByteArrayToStringStream(
             buffer, 0, buffer.size()) << "}\n";
     utils::Logger::Instance().Debug(oss.str().c_str());
-    houselinc_server_->SendData(buffer);
+    if (!houselinc_server_)
+        return; // messages during the startup sync, nobody is connected
+    houselinc_server_->SendData(
+            std::make_shared<const std::vector<uint8_t>>(buffer), session_id);
 }
 } // namespace ace
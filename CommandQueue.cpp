@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "include/insteon/CommandQueue.hpp"
+#include "include/system/HandlerProfiler.hpp"
+
+namespace ace {
+namespace insteon {
+
+CommandQueue::CommandQueue(boost::asio::io_service::strand& io_strand)
+: io_strand_(io_strand), running_(false) {
+}
+
+/**
+ * Post
+ * 
+ * Queues a job in the given lane and starts the queue if it is idle.
+ * @param priority lane to queue the job in
+ * @param work the job, runs on the network strand
+ */
+void
+CommandQueue::post(CommandPriority priority, job work) {
+    postAsync(priority, [work](std::function<void() > done) {
+        work();
+        done();
+    });
+}
+
+/**
+ * PostAsync
+ * 
+ * Queues a job which finishes later, ie: once a device response arrives.
+ * The queue is held until the job calls done, no thread waits meanwhile.
+ * @param priority lane to queue the job in
+ * @param work the job, starts on the network strand
+ */
+void
+CommandQueue::postAsync(CommandPriority priority, async_job work) {
+    std::lock_guard<std::mutex>lock(lock_);
+    lanes_[static_cast<std::size_t> (priority)].push_back(std::move(work));
+    if (running_)
+        return;
+    running_ = true;
+    io_strand_.post(system::profile("CommandQueue::runNext",
+            std::bind(&type::runNext, this)));
+}
+
+std::size_t
+CommandQueue::pending(CommandPriority priority) {
+    std::lock_guard<std::mutex>lock(lock_);
+    return lanes_[static_cast<std::size_t> (priority)].size();
+}
+
+boost::asio::io_service::strand&
+CommandQueue::strand() {
+    return io_strand_;
+}
+
+bool
+CommandQueue::idle() {
+    std::lock_guard<std::mutex>lock(lock_);
+    return !running_;
+}
+
+/**
+ * RunNext
+ * 
+ * Starts the first job of the highest priority lane. Once the job is done
+ * runNext is rescheduled through the strand so other handlers on the strand
+ * are not starved.
+ */
+void
+CommandQueue::runNext() {
+    async_job work;
+    {
+        std::lock_guard<std::mutex>lock(lock_);
+        for (auto& lane : lanes_) {
+            if (lane.empty())
+                continue;
+            work = std::move(lane.front());
+            lane.pop_front();
+            break;
+        }
+        if (!work) {
+            running_ = false;
+            return;
+        }
+    }
+
+    work(std::bind(&type::finish, this));
+}
+
+// reschedules runNext while there is work, otherwise the queue goes idle
+void
+CommandQueue::finish() {
+    std::lock_guard<std::mutex>lock(lock_);
+    for (const auto& lane : lanes_) {
+        if (!lane.empty()) {
+            io_strand_.post(system::profile("CommandQueue::runNext",
+                    std::bind(&type::runNext, this)));
+            return;
+        }
+    }
+    running_ = false;
+}
+
+} // namespace insteon
+} // namespace ace
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "include/insteon/CommandSequence.hpp"
+#include "include/insteon/InsteonDevice.hpp"
+
+namespace ace {
+namespace insteon {
+
+std::shared_ptr<CommandSequence>
+CommandSequence::create(CommandQueue& queue, CommandPriority priority) {
+    return std::shared_ptr<CommandSequence>(
+            new CommandSequence(queue, priority));
+}
+
+CommandSequence::CommandSequence(CommandQueue& queue, CommandPriority priority)
+: queue_(queue), io_strand_(queue.strand()), priority_(priority),
+deadline_(queue.strand().get_io_service()), timeout_(0), next_(0),
+keep_going_(false), cancelled_(false), result_(InsteonCommandStatus::Ack) {
+}
+
+std::shared_ptr<CommandSequence>
+CommandSequence::then(step work) {
+    steps_.push_back(std::move(work));
+    return shared_from_this();
+}
+
+std::shared_ptr<CommandSequence>
+CommandSequence::then(std::shared_ptr<InsteonDevice> device,
+        InsteonDeviceCommand command, uint8_t command_two) {
+    // steps only run while the sequence holds itself, this stays valid
+    return then([this, device, command, command_two](handler next) {
+        execute(device, command, command_two, next);
+    });
+}
+
+// the whole sequence ends with Timeout once the deadline passes
+std::shared_ptr<CommandSequence>
+CommandSequence::timeout(std::chrono::milliseconds timeout) {
+    timeout_ = timeout;
+    return shared_from_this();
+}
+
+// runs every step, the result is then the first failure
+std::shared_ptr<CommandSequence>
+CommandSequence::keepGoing() {
+    keep_going_ = true;
+    return shared_from_this();
+}
+
+/**
+ * Start
+ * 
+ * Runs the steps in order on the network strand.
+ * @param done receives Ack when every step was acknowledged, otherwise the
+ * status which ended the sequence, may be empty
+ */
+void
+CommandSequence::start(handler done) {
+    auto self(shared_from_this());
+    io_strand_.post([this, self, done]() {
+        done_ = done;
+        statuses_.assign(steps_.size(), InsteonCommandStatus::Cancelled);
+        if (timeout_.count() > 0) {
+            deadline_.expires_from_now(timeout_);
+            deadline_.async_wait(io_strand_.wrap([this, self](
+                    const boost::system::error_code& ec) {
+                if (ec == boost::asio::error::operation_aborted)
+                    return;
+                finish(InsteonCommandStatus::Timeout);
+            }));
+        }
+        runNext();
+    });
+}
+
+/**
+ * Cancel
+ * 
+ * Ends the sequence with Cancelled, steps which weren't sent yet never are.
+ * A command already handed to the PLM can't be recalled, its outcome is
+ * ignored.
+ */
+void
+CommandSequence::cancel() {
+    auto self(shared_from_this());
+    io_strand_.post([this, self]() {
+        finish(InsteonCommandStatus::Cancelled);
+    });
+}
+
+const std::vector<InsteonCommandStatus>&
+CommandSequence::statuses() const {
+    return statuses_;
+}
+
+/**
+ * Execute
+ * 
+ * Queues a single device command in the lane of this sequence, done is
+ * called on the network strand. Nothing is sent once the sequence is
+ * cancelled or finished, done then receives Cancelled.
+ */
+void
+CommandSequence::execute(std::shared_ptr<InsteonDevice> device,
+        InsteonDeviceCommand command, uint8_t command_two, handler done) {
+    auto self(shared_from_this());
+    queue_.postAsync(priority_, [this, self, device, command, command_two,
+            done](std::function<void() > release) {
+        // queue jobs start on io_strand_
+        if (cancelled_) {
+            release();
+            done(InsteonCommandStatus::Cancelled);
+            return;
+        }
+        device->asyncExecute(command, command_two,
+                [release, done](InsteonCommandStatus status) {
+                    release();
+                    done(status);
+                });
+    });
+}
+
+void
+CommandSequence::runNext() {
+    if (cancelled_)
+        return;
+    if (next_ == steps_.size()) {
+        finish(result_);
+        return;
+    }
+    std::size_t index = next_++;
+    auto self(shared_from_this());
+    steps_[index]([this, self, index](InsteonCommandStatus status) {
+        io_strand_.post(std::bind(&type::stepDone, self, index, status));
+    });
+}
+
+void
+CommandSequence::stepDone(std::size_t index, InsteonCommandStatus status) {
+    if (cancelled_)
+        return; // the outcome of a step that was cut short
+    statuses_[index] = status;
+    if (status != InsteonCommandStatus::Ack) {
+        if (result_ == InsteonCommandStatus::Ack)
+            result_ = status;
+        if (!keep_going_) {
+            finish(status);
+            return;
+        }
+    }
+    runNext();
+}
+
+// runs on io_strand_, only the first call does anything
+void
+CommandSequence::finish(InsteonCommandStatus status) {
+    if (cancelled_)
+        return;
+    cancelled_ = true;
+    deadline_.cancel();
+    steps_.clear(); // the steps may hold on to this sequence
+    handler done;
+    done.swap(done_);
+    if (done)
+        done(status);
+}
+
+} // namespace insteon
+} // namespace ace
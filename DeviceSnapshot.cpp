@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "include/insteon/DeviceSnapshot.hpp"
+
+#include "include/Logger.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ace {
+namespace insteon {
+
+namespace {
+
+const char kMagic[4] = {'A', 'H', 'S', 'S'};
+const uint32_t kVersion = 1;
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t record_size;
+};
+
+bool
+writeAll(int fd, const void* data, std::size_t size) {
+    const char* it = static_cast<const char*> (data);
+    while (size > 0) {
+        ssize_t written = ::write(fd, it, size);
+        if (written < 0)
+            return false;
+        it += written;
+        size -= static_cast<std::size_t> (written);
+    }
+    return true;
+}
+
+// makes a rename into the directory of path durable
+void
+syncDirectory(const std::string& path) {
+    std::string::size_type slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." :
+            slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return;
+    ::fsync(fd);
+    ::close(fd);
+}
+
+} // namespace
+
+/**
+ * Write
+ * 
+ * Writes every record to a temporary file which is flushed to disk before
+ * it replaces the snapshot, a crash while writing never leaves a truncated
+ * snapshot behind.
+ * 
+ * @param path snapshot file
+ * @param records
+ * @return false if the file could not be written
+ */
+bool
+DeviceSnapshot::write(const std::string& path,
+        const std::vector<DeviceSnapshotRecord>& records) {
+    SnapshotHeader header;
+    std::memcpy(header.magic, kMagic, sizeof (kMagic));
+    header.version = kVersion;
+    header.count = static_cast<uint32_t> (records.size());
+    header.record_size = sizeof (DeviceSnapshotRecord);
+
+    std::string temp = path + ".tmp";
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    bool written = writeAll(fd, &header, sizeof (header)) &&
+            writeAll(fd, records.data(),
+            records.size() * sizeof (DeviceSnapshotRecord)) &&
+            ::fsync(fd) == 0;
+    if (::close(fd) != 0 || !written) {
+        std::remove(temp.c_str());
+        return false;
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0)
+        return false;
+    syncDirectory(path);
+    return true;
+}
+
+/**
+ * Load
+ * 
+ * Maps the snapshot file and visits every record.
+ * 
+ * @param path snapshot file
+ * @param visit invoked once per record
+ * @return false if the file is missing or not a valid snapshot
+ */
+bool
+DeviceSnapshot::load(const std::string& path,
+        const std::function<void(const DeviceSnapshotRecord&)>& visit) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+            static_cast<std::size_t> (st.st_size) < sizeof (SnapshotHeader)) {
+        ::close(fd);
+        return false;
+    }
+    std::size_t size = st.st_size;
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    const char* data = static_cast<const char*> (map);
+    SnapshotHeader header;
+    std::memcpy(&header, data, sizeof (header));
+    bool valid = std::memcmp(header.magic, kMagic, sizeof (kMagic)) == 0 &&
+            header.version == kVersion &&
+            header.record_size == sizeof (DeviceSnapshotRecord) &&
+            size >= sizeof (header) +
+            std::size_t(header.count) * sizeof (DeviceSnapshotRecord);
+    if (valid) {
+        const char* it = data + sizeof (header);
+        for (uint32_t i = 0; i < header.count; ++i) {
+            DeviceSnapshotRecord record;
+            std::memcpy(&record, it, sizeof (record));
+            it += sizeof (record);
+            visit(record);
+        }
+    } else {
+        utils::Logger::Instance().Warning("%s\n\t  - ignoring invalid "
+                "snapshot: %s", FUNCTION_NAME_CSTR, path.c_str());
+    }
+    ::munmap(map, size);
+    return valid;
+}
+
+} // namespace insteon
+} // namespace ace
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "include/insteon/GroupProvisioner.hpp"
+
+#include <algorithm>
+
+namespace ace {
+namespace insteon {
+
+constexpr std::size_t GroupProvisioner::kMaxTracked;
+constexpr std::size_t GroupProvisioner::kMaxBurst;
+
+GroupProvisioner::GroupProvisioner()
+: tick_(0), threshold_(3), window_(2000) {
+}
+
+/**
+ * Configure
+ * 
+ * @param threshold times a set is commanded before it is suggested
+ * @param window longest pause between single commands of the same set
+ */
+void
+GroupProvisioner::configure(unsigned threshold,
+        std::chrono::milliseconds window) {
+    std::lock_guard<std::mutex>lock(lock_);
+    threshold_ = threshold;
+    window_ = window;
+}
+
+void
+GroupProvisioner::normalize(device_set& devices) {
+    for (auto& it : devices)
+        it &= 0xFFFFFF;
+    std::sort(devices.begin(), devices.end());
+    devices.erase(std::unique(devices.begin(), devices.end()), devices.end());
+}
+
+/**
+ * Observe
+ * 
+ * Records that the devices were commanded together, ie: by a batch.
+ * @param devices
+ * @param suggestion set when devices should be suggested as a group
+ * @return true if a suggestion was made
+ */
+bool
+GroupProvisioner::observe(device_set devices, device_set& suggestion) {
+    normalize(devices);
+    std::lock_guard<std::mutex>lock(lock_);
+    return count(devices, suggestion);
+}
+
+/**
+ * ObserveCommand
+ * 
+ * Records a single command. Commands less than window apart form a burst,
+ * a burst is counted as a set once the next pause ends it.
+ * @param device_id
+ * @param when
+ * @param suggestion
+ * @return true if a suggestion was made
+ */
+bool
+GroupProvisioner::observeCommand(uint32_t device_id, time_point when,
+        device_set& suggestion) {
+    std::lock_guard<std::mutex>lock(lock_);
+    bool suggested = false;
+    if (!burst_.empty() && when - burst_last_ > window_) {
+        device_set devices;
+        devices.swap(burst_);
+        normalize(devices);
+        suggested = count(devices, suggestion);
+    }
+    if (std::find(burst_.begin(), burst_.end(), device_id) == burst_.end()) {
+        // a burst this long is a stream of traffic, not a scene
+        if (burst_.size() >= kMaxBurst)
+            burst_.clear();
+        burst_.push_back(device_id);
+    }
+    burst_last_ = when;
+    return suggested;
+}
+
+/**
+ * Provisioned
+ * 
+ * The devices now share a PLM group, there is nothing left to suggest.
+ * @param devices
+ */
+void
+GroupProvisioner::provisioned(device_set devices) {
+    normalize(devices);
+    std::lock_guard<std::mutex>lock(lock_);
+    if (devices.size() < 2)
+        return;
+    track(devices).suggested = true;
+}
+
+// must be called with lock_ held
+bool
+GroupProvisioner::count(const device_set& devices, device_set& suggestion) {
+    if (threshold_ == 0 || devices.size() < 2)
+        return false;
+    usage& entry = track(devices);
+    if (entry.suggested || ++entry.count < threshold_)
+        return false;
+    entry.suggested = true;
+    suggestion = devices;
+    return true;
+}
+
+/*
+ * Finds or adds the set, marking it used. When the table is full the least
+ * recently used set that was never suggested makes room, failing that the
+ * least recently used set of all.
+ * must be called with lock_ held
+ */
+GroupProvisioner::usage&
+GroupProvisioner::track(const device_set& devices) {
+    auto it = sets_.find(devices);
+    if (it == sets_.end()) {
+        if (sets_.size() >= kMaxTracked) {
+            auto victim = sets_.end();
+            for (auto set = sets_.begin(); set != sets_.end(); ++set) {
+                if (victim == sets_.end()
+                        || set->second.suggested < victim->second.suggested
+                        || (set->second.suggested == victim->second.suggested
+                        && set->second.used < victim->second.used))
+                    victim = set;
+            }
+            sets_.erase(victim);
+        }
+        it = sets_.emplace(devices, usage{0, false, 0}).first;
+    }
+    it->second.used = ++tick_;
+    return it->second;
+}
+
+} // namespace insteon
+} // namespace ace
@@ -34,6 +34,7 @@
 
 #include "include/Logger.h"
 #include "include/system/Timer.hpp"
+#include "include/system/HandlerProfiler.hpp"
 #include "include/utils/utils.hpp"
 
 #include <memory>
@@ -46,17 +47,23 @@ namespace ace
 namespace insteon
 {
 
+namespace
+{
+// the PLM reports 0x58 only after every responder got its cleanup, each one
+// may take several hops and retries
+const std::chrono::milliseconds kCleanupBase(4000);
+const std::chrono::milliseconds kCleanupPerResponder(1000);
+}
+
 InsteonController::InsteonController(InsteonNetwork *network,
         boost::asio::io_service& io_service)
-: insteon_network_(network), is_loading_database_(false),
-pImpl_(new detail::InsteonController_impl) {
+: pImpl_(new detail::InsteonController_impl), insteon_network_(network),
+is_loading_database_(false) {
 
     pImpl_->timer_ = std::move(
             std::unique_ptr<system::Timer>(new system::Timer(io_service)));
     pImpl_->timer_->SetTimerCallback(
             std::bind(&InsteonController::onTimerEvent, this));
-    pImpl_->timer_->RunAsync();
-    pImpl_->timer_->Stop();
 }
 
 InsteonController::~InsteonController() {
@@ -77,22 +84,161 @@ InsteonController::getAddress() {
             pImpl_->insteon_address_.address_low_;
 }
 
+/**
+ * LoadDatabase
+ * 
+ * Walks the PLM all-link database with Get First (0x69) and Get Next (0x6A)
+ * All-Link Record. Each record arrives as a 0x57 message, which requests the
+ * next one, a NAK marks the end of the database. These commands never reach
+ * the powerline so they are sent without the command_delay pacing.
+ */
 void
-InsteonController::getDatabaseRecords(uint8_t one, uint8_t two) {
-    is_loading_database_ = true;
-    if ((one == 0x1C) && (two == 0x00)) {
+InsteonController::loadDatabase() {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    {
+        std::lock_guard<std::mutex>lock(database_lock_);
+        is_loading_database_ = true;
+        database_pending_.clear();
+        database_started_ = std::chrono::steady_clock::now();
+    }
+    insteon_network_->io_strand_.post(system::profile(
+            "InsteonController::requestDatabaseRecord", std::bind(
+            &type::requestDatabaseRecord, this, 0x69)));
+}
+
+/**
+ * WaitForDatabase
+ * 
+ * Blocks until the database is loaded or the timeout expires. A load that
+ * times out is abandoned and the previous database is kept.
+ * 
+ * @param timeout
+ * @return true if the database was loaded
+ */
+bool
+InsteonController::waitForDatabase(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex>lock(database_lock_);
+    if (database_loaded_.wait_for(lock, timeout, [this] {
+            return !is_loading_database_;
+        }))
+        return true;
+    is_loading_database_ = false;
+    utils::Logger::Instance().Warning("%s\n\t  - PLM database not loaded "
+            "within %lld ms, %d records received", FUNCTION_NAME_CSTR,
+            (long long) timeout.count(), database_pending_.size());
+    database_pending_.clear();
+    return false;
+}
+
+std::vector<InsteonLinkRecord>
+InsteonController::database() {
+    std::lock_guard<std::mutex>lock(database_lock_);
+    return database_;
+}
+
+/**
+ * FreeGroup
+ * 
+ * @return the lowest group the PLM isn't a controller of, -1 if none
+ */
+int
+InsteonController::freeGroup() {
+    std::vector<bool> used(256, false);
+    used[0] = true; // group 0 is used while linking
+    {
+        std::lock_guard<std::mutex>lock(database_lock_);
+        for (const auto& record : database_) {
+            if (record.in_use() && record.controller())
+                used[record.group] = true;
+        }
+    }
+    for (int group = 1; group < 255; group++) {
+        if (!used[group])
+            return group;
+    }
+    return -1;
+}
+
+/**
+ * TryAddLinkRecord
+ * 
+ * Adds a record to the PLM database with Manage All-Link Record (0x6F).
+ * @param record controller() selects a controller or a responder record
+ * @return true if the PLM accepted the record
+ */
+bool
+InsteonController::tryAddLinkRecord(InsteonLinkRecord record) {
+    std::vector<uint8_t> send_buffer = {0x6F,
+        (uint8_t) (record.controller() ? 0x40 : 0x41), record.flags,
+        record.group, (uint8_t) (record.link_address >> 16 & 0xFF),
+        (uint8_t) (record.link_address >> 8 & 0xFF),
+        (uint8_t) (record.link_address & 0xFF), record.data_one,
+        record.data_two, record.data_three};
+    if (insteon_network_->msg_proc_->trySend(send_buffer, false)
+            != PlmEcho::ACK)
+        return false;
+
+    std::vector<InsteonLinkRecord> records;
+    {
+        std::lock_guard<std::mutex>lock(database_lock_);
+        // 0x6F doesn't report the slot the PLM used, the next load will
+        record.memory_address = 0;
+        database_.push_back(record);
+        records = database_;
+    }
+    insteon_network_->link_table_.update(getAddress(), records);
+    return true;
+}
+
+/**
+ * RequestDatabaseRecord
+ * 
+ * @param command 0x69 for the first record, 0x6A for the next
+ */
+void
+InsteonController::requestDatabaseRecord(uint8_t command) {
+    {
+        std::lock_guard<std::mutex>lock(database_lock_);
+        if (!is_loading_database_)
+            return;
+    }
+    std::vector<uint8_t> send_buffer = {command};
+    PlmEcho status = insteon_network_->msg_proc_->trySendNow(send_buffer,
+            false, send_buffer.size());
+    if (status == PlmEcho::NAK)
+        finishDatabase(true); // no more records
+    else if (status != PlmEcho::ACK)
+        finishDatabase(false);
+}
+
+/**
+ * FinishDatabase
+ * 
+ * @param complete true replaces the database with the records just read
+ */
+void
+InsteonController::finishDatabase(bool complete) {
+    std::vector<InsteonLinkRecord> records;
+    {
+        std::lock_guard<std::mutex>lock(database_lock_);
+        if (!is_loading_database_)
+            return;
         is_loading_database_ = false;
-        insteon_network_->cv_load_db_.notify_one();
-        return;
+        if (complete) {
+            database_.swap(database_pending_);
+            records = database_;
+        }
+        database_pending_.clear();
+        utils::Logger::Instance().Info("%s\n\t  - PLM database %s, "
+                "%d records in %lld ms", FUNCTION_NAME_CSTR,
+                complete ? "loaded" : "failed", database_.size(),
+                (long long) std::chrono::duration_cast<
+                std::chrono::milliseconds>(std::chrono::steady_clock::now()
+                - database_started_).count());
     }
-    std::vector<uint8_t> send_buffer = {0x75};
-    send_buffer.push_back(one);
-    send_buffer.push_back(two);
-
-    //std::vector<uint8_t> send_buffer = {0x69};
-    //insteon_network_->io_service_.post(std::bind(
-    //        &type::InternalSend, this, send_buffer));
-    insteon_network_->msg_proc_->trySend(send_buffer, false);
+    if (complete)
+        insteon_network_->link_table_.update(getAddress(), records);
+    database_loaded_.notify_all();
 }
 
 void
@@ -172,13 +318,40 @@ InsteonController::groupCommand(InsteonControllerGroupCommands command,
 bool
 InsteonController::tryGroupCommand(InsteonControllerGroupCommands command,
         uint8_t group) {
-    return false;
+    uint8_t value = 0;
+    if (command == InsteonControllerGroupCommands::StopDimming)
+        return false;
+    if (command == InsteonControllerGroupCommands::On)
+        value = 0xFF;
+    return tryGroupCommand(command, group, value);
 }
 
+/**
+ * TryGroupCommand
+ * 
+ * Broadcasts a group command, the PLM then sends a cleanup to every
+ * responder of the group and reports with 0x58 once they are done. The wait
+ * for the report grows with the responders in the link table.
+ * 
+ * @param command
+ * @param group
+ * @param value
+ * @return true if every responder acknowledged its cleanup
+ */
 bool
 InsteonController::tryGroupCommand(InsteonControllerGroupCommands command,
         uint8_t group, uint8_t value) {
-    return false;
+    std::vector<uint8_t> send_buffer = {0x61, group, (uint8_t) command, value};
+    PropertyKeys properties;
+    std::size_t responders = insteon_network_->link_table_.responders(
+            getAddress(), group).size();
+    std::chrono::milliseconds timeout = kCleanupBase +
+            kCleanupPerResponder * responders;
+    // no retries, a second broadcast would restart the cleanups
+    PlmEcho status = insteon_network_->msg_proc_->trySendReceive(send_buffer,
+            0, 0x58, properties, timeout);
+    return status == PlmEcho::ACK && properties.count("link_status") &&
+            properties["link_status"] == 0x06;
 }
 
 void
@@ -251,9 +424,15 @@ InsteonController::onMessage(
                     "do something with them");
             break;
         case insteon::InsteonMessageType::DeviceLinkRecord:
+            processDatabaseRecord(im);
+            break;
+        case insteon::InsteonMessageType::DeviceLinkCleanup:
+            utils::Logger::Instance().Debug("%s\n\t  - group cleanup %s",
+                    FUNCTION_NAME_CSTR, im->properties_["link_status"] == 0x06
+                    ? "completed" : "failed");
+            break;
         case insteon::InsteonMessageType::ALDBRecord:
             utils::Logger::Instance().Info("ALDB record received");
-            //processDatabaseRecord(im);
             break;
         default:
             utils::Logger::Instance().Info("%s\n\t - unexpected message: {%s}\n",
@@ -266,43 +445,32 @@ InsteonController::onMessage(
     }
 }
 
+/**
+ * ProcessDatabaseRecord
+ * 
+ * Stores a 0x57 record of the database being loaded and asks for the next.
+ * Devices found in the database are added to the network.
+ * 
+ * @param im
+ */
 void
 InsteonController::processDatabaseRecord(
         std::shared_ptr<insteon::InsteonMessage> im) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
-    uint32_t address = 0;
-    address = im->properties_["link_address"];
-    if (address > 0)
-        insteon_network_->addDevice(address);
-    bool get_next = false;
-    uint32_t has_flags = im->properties_["link_record_flags"];
-    get_next = has_flags > 0;
-    if (get_next) {
-        uint16_t temp = 0;
-        uint8_t one = im->properties_["db_address_MSB"];
-        uint8_t two = im->properties_["db_address_LSB"];
-
-        utils::Logger::Instance().Debug("Database record found.\n"
-                "\t  Memory location MSB: %d\n"
-                "\t  Memory location LSB: %d\n"
-                "\t  Link Record Flags: %i\n"
-                "\t  Link Group: %d\n"
-                "\t  Device Address: %s",
-                im->properties_["db_address_MSB"],
-                im->properties_["db_address_LSB"],
-                im->properties_["link_record_flags"],
-                im->properties_["link_group"],
-                utils::int_to_hex(im->properties_["link_address"]).c_str());
-
-        temp = (one << 8) | (two);
-        temp -= 8;
-        one = (temp >> 8) & 0xFF;
-        two = temp & 0xFF;
-        getDatabaseRecords(one, two);
-    } else {
-        is_loading_database_ = false;
-        insteon_network_->cv_load_db_.notify_one();
+    InsteonLinkRecord record(im->properties_);
+    {
+        std::lock_guard<std::mutex>lock(database_lock_);
+        if (!is_loading_database_)
+            return;
+        // PLM records have no memory address, keep their position instead
+        record.memory_address = database_pending_.size();
+        database_pending_.push_back(record);
     }
+    if (record.link_address > 0)
+        insteon_network_->addDevice(record.link_address);
+    insteon_network_->io_strand_.post(system::profile(
+            "InsteonController::requestDatabaseRecord", std::bind(
+            &type::requestDatabaseRecord, this, 0x6A)));
 }
 } // namespace insteon
 } // namespace ace
@@ -30,12 +30,14 @@
 #include "include/insteon/MessageProcessor.hpp"
 
 #include "include/Logger.h"
+#include "include/system/HandlerProfiler.hpp"
 #include "include/utils/utils.hpp"
 
 #include "include/json/json.h"
 #include "include/json/json-forwards.h"
 
 #include <iostream>
+#include <algorithm>
 
 namespace ace
 {
@@ -45,14 +47,17 @@ namespace insteon
 InsteonDevice::InsteonDevice(uint32_t insteon_address,
         boost::asio::io_service::strand& io_strand, YAML::Node config) :
 io_strand_(io_strand), config_(config), direct_cmd_(0x19),
-device_disabled_(false) {
+device_disabled_(false), status_ttl_(600), extended_requested_(false),
+last_seen_(0), aldb_delta_(-1), aldb_loading_(false),
+aldb_timer_(io_strand.get_io_service()), aldb_timeout_(5000) {
 
     insteon_address_.setAddress(insteon_address);
     device_name_ = ace::utils::int_to_hex<int>(insteon_address);
 
-    device_properties_["light_status"] = 0;
+    device_state_.write(DeviceProperty::LightStatus, 0);
     loadCommandMap();
     loadProperties();
+    loadALDB();
 }
 
 InsteonDevice::~InsteonDevice() {
@@ -63,26 +68,53 @@ void
 InsteonDevice::internalReceiveCommand(std::string command,
         uint8_t command_two) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
+    InsteonDeviceCommand resolved;
+    uint8_t value = 0x00;
+    if (resolveCommand(command, command_two, resolved, value)) {
+        io_strand_.post(system::profile(
+                "InsteonDevice::command", std::bind(&type::command,
+                this, resolved, value)));
+    }
+}
+
+/**
+ * ResolveCommand
+ * 
+ * Translates a client command name into an INSTEON command.
+ * Commands not native to INSTEON, ie: toggle, are resolved against the
+ * current state of this device.
+ * 
+ * @param command The command name, ie: on, off, toggle
+ * @param command_two The command_two value supplied by the client
+ * @param resolved Receives the INSTEON command
+ * @param value Receives the command_two value to send
+ * @return false if the command is unknown
+ */
+bool
+InsteonDevice::resolveCommand(const std::string& command,
+        uint8_t command_two, InsteonDeviceCommand& resolved, uint8_t& value) {
     auto it = command_map_.find(command);
     if (it != command_map_.end()) {
-        io_strand_.post(std::bind(&type::command, this, it->second,
-                command_two));
-    } else { // support for commands not native to INSTEON
-
-        std::string other_cmd = command;
-        std::transform(other_cmd.begin(), other_cmd.end(),
-                other_cmd.begin(), ::tolower);
-
-        if (other_cmd.compare("toggle") == 0) {
-            if (readDeviceProperty("light_status", 0) == 0) {
-                io_strand_.post(std::bind(&type::command, this,
-                        InsteonDeviceCommand::On, 0xFF));
-            } else {
-                io_strand_.post(std::bind(&type::command, this,
-                        InsteonDeviceCommand::Off, 0x00));
-            }
+        resolved = it->second;
+        value = command_two;
+        return true;
+    }
+    // support for commands not native to INSTEON
+    std::string other_cmd = command;
+    std::transform(other_cmd.begin(), other_cmd.end(),
+            other_cmd.begin(), ::tolower);
+
+    if (other_cmd.compare("toggle") == 0) {
+        if (readDeviceProperty(DeviceProperty::LightStatus, 0) == 0) {
+            resolved = InsteonDeviceCommand::On;
+            value = 0xFF;
+        } else {
+            resolved = InsteonDeviceCommand::Off;
+            value = 0x00;
         }
+        return true;
     }
+    return false;
 }
 
 uint32_t
@@ -136,58 +168,68 @@ InsteonDevice::ackOfDirectCommand(const std::shared_ptr<InsteonMessage>& im) {
     InsteonDeviceCommand command = static_cast<InsteonDeviceCommand> (direct_cmd_);
     switch (command) {
         case InsteonDeviceCommand::GetInsteonEngineVersion:
-            writeDeviceProperty("device_engine_version", recvCmdTwo);
+            writeDeviceProperty(DeviceProperty::DeviceEngineVersion,
+                    recvCmdTwo);
             break;
         case InsteonDeviceCommand::GetOperatingFlags:
         {
-            writeDeviceProperty("enable_programming_lock", recvCmdTwo & 0x01);
-            writeDeviceProperty("enable_blink_on_traffic", recvCmdTwo & 0x02);
-            writeDeviceProperty("enable_resume_dim", recvCmdTwo & 0x04);
-            writeDeviceProperty("enable_led", recvCmdTwo & 0x08);
-            writeDeviceProperty("enable_load_sense", recvCmdTwo & 0x0a);
+            writeDeviceProperty(DeviceProperty::EnableProgrammingLock,
+                    recvCmdTwo & 0x01);
+            writeDeviceProperty(DeviceProperty::EnableBlinkOnTraffic,
+                    recvCmdTwo & 0x02);
+            writeDeviceProperty(DeviceProperty::EnableResumeDim,
+                    recvCmdTwo & 0x04);
+            writeDeviceProperty(DeviceProperty::EnableLed, recvCmdTwo & 0x08);
+            writeDeviceProperty(DeviceProperty::EnableLoadSense,
+                    recvCmdTwo & 0x0a);
         }
             break;
         case InsteonDeviceCommand::Dim:
         {
-            float oValue = readDeviceProperty("light_status", 0);
+            float oValue = readDeviceProperty(DeviceProperty::LightStatus, 0);
             float nValue = round(oValue / 8) - 1;
             nValue = nValue < 1 ? 0 : (nValue * 8) - 1;
-            io_strand_.get_io_service().post(std::bind(&type::statusUpdate,
-                    this, nValue));
+            io_strand_.get_io_service().post(system::profile(
+                    "InsteonDevice::statusUpdate", std::bind(&type::statusUpdate,
+                    this, nValue, StatusSource::DirectAck)));
         }
             break;
         case InsteonDeviceCommand::Brighten:
         {
-            float oValue = readDeviceProperty("light_status", 0);
+            float oValue = readDeviceProperty(DeviceProperty::LightStatus, 0);
             float nValue = round(oValue / 8) + 1;
             nValue = nValue > 31 ? 255 : (nValue * 8) - 1;
-            io_strand_.get_io_service().post(std::bind(&type::statusUpdate,
-                    this, nValue));
+            io_strand_.get_io_service().post(system::profile(
+                    "InsteonDevice::statusUpdate", std::bind(&type::statusUpdate,
+                    this, nValue, StatusSource::DirectAck)));
         }
             break;
         case InsteonDeviceCommand::Off:
         case InsteonDeviceCommand::FastOff:
-            io_strand_.get_io_service().post(std::bind(&type::statusUpdate,
-                    this, 0x00));
+            io_strand_.get_io_service().post(system::profile(
+                    "InsteonDevice::statusUpdate", std::bind(&type::statusUpdate,
+                    this, 0x00, StatusSource::DirectAck)));
             break;
         case InsteonDeviceCommand::On:
-            io_strand_.get_io_service().post(std::bind(&type::statusUpdate,
-                    this, recvCmdTwo));
+            io_strand_.get_io_service().post(system::profile(
+                    "InsteonDevice::statusUpdate", std::bind(&type::statusUpdate,
+                    this, recvCmdTwo, StatusSource::DirectAck)));
             break;
         case InsteonDeviceCommand::FastOn:
-            io_strand_.get_io_service().post(std::bind(&type::statusUpdate,
-                    this, 0xFF));
+            io_strand_.get_io_service().post(system::profile(
+                    "InsteonDevice::statusUpdate", std::bind(&type::statusUpdate,
+                    this, 0xFF, StatusSource::DirectAck)));
             break;
         case InsteonDeviceCommand::LightStatusRequest:
         {
-            writeDeviceProperty("link_database_delta", recvCmdOne);
-            io_strand_.get_io_service().post(std::bind(&type::statusUpdate,
-                    this, recvCmdTwo));
+            writeDeviceProperty(DeviceProperty::LinkDatabaseDelta, recvCmdOne);
+            io_strand_.get_io_service().post(system::profile(
+                    "InsteonDevice::statusUpdate", std::bind(&type::statusUpdate,
+                    this, recvCmdTwo, StatusSource::StatusRequest)));
         }
             break;
         case InsteonDeviceCommand::StopDimming:
-            io_strand_.post(std::bind(&type::command, this,
-                    InsteonDeviceCommand::LightStatusRequest, 0x02));
+            poll(InsteonDeviceCommand::LightStatusRequest, 0x02);
             break;
         default:
             /*io_strand_.get_io_service().post(std::bind(&type::statusUpdate,
@@ -216,14 +258,15 @@ void InsteonDevice::loadCommandMap() {
  * Loads device object properties from yaml-cpp object
  */
 void InsteonDevice::loadProperties() {
-    std::lock_guard<std::mutex>lock(property_lock_);
+    std::lock_guard<std::mutex>lock(config_lock_);
     device_name(config_["device_name_"].as<std::string>(
             utils::int_to_hex(insteon_address())));
     device_disabled(config_["device_disabled_"].as<bool>(false));
+    last_seen_ = config_["last_seen_"].as<int64_t>(0);
     YAML::Node node = config_["properties_"];
     for (auto it = node.begin(); it != node.end(); ++it) {
-        device_properties_[it->first.as<std::string>()]
-                = it->second.as<uint16_t>();
+        device_state_.write(it->first.as<std::string>(),
+                it->second.as<uint16_t>());
     }
 }
 
@@ -231,10 +274,11 @@ void
 InsteonDevice::OnMessage(std::shared_ptr<InsteonMessage> im) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
     PropertyKeys keys = im->properties_;
+    touch();
     uint8_t command_one = keys["command_one"];
     uint8_t command_two = keys["command_two"];
-    uint8_t set_level = readDeviceProperty("button_on_level", 0);
-    uint8_t current_level = readDeviceProperty("light_status", 0);
+    uint8_t set_level = readDeviceProperty(DeviceProperty::ButtonOnLevel, 0);
+    uint8_t current_level = readDeviceProperty(DeviceProperty::LightStatus, 0);
 
     if (im->properties_.size() > 0) {
         std::ostringstream oss;
@@ -260,49 +304,70 @@ InsteonDevice::OnMessage(std::shared_ptr<InsteonMessage> im) {
     }
 
     if (!set_level) {
-        io_strand_.post(std::bind(&type::command, this,
-                InsteonDeviceCommand::LightStatusRequest, 0x02));
-        io_strand_.post(std::bind(&type::command, this,
-                InsteonDeviceCommand::ExtendedGetSet, 0x00));
+        // the on level is learned once, not on every message
+        if (!extended_requested_.exchange(true))
+            poll(InsteonDeviceCommand::ExtendedGetSet, 0x00);
+        if (statusUncertain())
+            poll(InsteonDeviceCommand::LightStatusRequest, 0x02);
     }
 
     switch (im->message_type_) {
         case InsteonMessageType::Ack: // response to direct command
-            ackOfDirectCommand(im);
+            // a group cleanup ack carries the group in command_two, the
+            // network accounts for it, see InsteonNetwork::executeScene
+            if (!keys["message_flags_group"])
+                ackOfDirectCommand(im);
             break;
             // device goes to set level at set ramp rate
         case InsteonMessageType::OnBroadcast:
             set_level = current_level != set_level ? set_level : 0xFF;
-            io_strand_.get_io_service().post(std::bind(&type::statusUpdate,
-                    this, set_level));
+            io_strand_.get_io_service().post(system::profile(
+                    "InsteonDevice::statusUpdate", std::bind(&type::statusUpdate,
+                    this, set_level, StatusSource::Broadcast)));
             break;
             // go to saved on level instantly
         case InsteonMessageType::FastOnBroadcast:
-            io_strand_.get_io_service().post(std::bind(&type::statusUpdate,
-                    this, 0xFF));
+            io_strand_.get_io_service().post(system::profile(
+                    "InsteonDevice::statusUpdate", std::bind(&type::statusUpdate,
+                    this, 0xFF, StatusSource::Broadcast)));
             break;
             // goes to off level instantly
         case InsteonMessageType::FastOffBroadcast:
             // goes to off level at set ramp rate
         case InsteonMessageType::OffBroadcast:
-            io_strand_.get_io_service().post(std::bind(&type::statusUpdate,
-                    this, 0x00));
+            io_strand_.get_io_service().post(system::profile(
+                    "InsteonDevice::statusUpdate", std::bind(&type::statusUpdate,
+                    this, 0x00, StatusSource::Broadcast)));
             break;
         case InsteonMessageType::IncrementEndBroadcast:
+            // manual dimming ended, the level can only be learned by asking
+            poll(InsteonDeviceCommand::LightStatusRequest, 0x00);
+            break;
+            // a cleanup repeats a broadcast, only poll if we missed it
         case InsteonMessageType::FastOffCleanup:
-        case InsteonMessageType::FastOnCleanup:
         case InsteonMessageType::OffCleanup:
+            if (current_level != 0 || statusUncertain()) {
+                poll(InsteonDeviceCommand::LightStatusRequest, 0x00);
+            } else {
+                device_state_.confirmStatus(StatusSource::Cleanup);
+            }
+            break;
+        case InsteonMessageType::FastOnCleanup:
         case InsteonMessageType::OnCleanup:
-            io_strand_.post(std::bind(&type::command, this,
-                    InsteonDeviceCommand::LightStatusRequest, 0x00));
+            if (current_level == 0 || statusUncertain()) {
+                poll(InsteonDeviceCommand::LightStatusRequest, 0x00);
+            } else {
+                device_state_.confirmStatus(StatusSource::Cleanup);
+            }
             break;
         case InsteonMessageType::IncrementBeginBroadcast:
             break;
         case InsteonMessageType::SetButtonPressed:
-            writeDeviceProperty("device_category", keys["device_category"]);
-            writeDeviceProperty("device_subcategory",
+            writeDeviceProperty(DeviceProperty::DeviceCategory,
+                    keys["device_category"]);
+            writeDeviceProperty(DeviceProperty::DeviceSubcategory,
                     keys["device_subcategory"]);
-            writeDeviceProperty("device_firmware_version",
+            writeDeviceProperty(DeviceProperty::DeviceFirmwareVersion,
                     keys["device_firmware_version"]);
 
             break;
@@ -314,7 +379,7 @@ InsteonDevice::OnMessage(std::shared_ptr<InsteonMessage> im) {
             direct_cmd_ = command_one;
             break;
         case InsteonMessageType::ALDBRecord:
-            utils::Logger::Instance().Debug("ALDB record received");
+            onALDBRecord(keys);
             break;
         default:
             utils::Logger::Instance().Debug("%s\n\t  - unknown message type "
@@ -329,13 +394,13 @@ InsteonDevice::OnMessage(std::shared_ptr<InsteonMessage> im) {
 Json::Value
 InsteonDevice::SerializeJson() {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
-    std::lock_guard<std::mutex>lock(property_lock_);
     Json::Value root;
     Json::Value properties;
     root["device_address_"] = insteon_address();
     root["device_name_"] = device_name();
-    root["device_disabled_"] = config_["device_disabled_"].as<bool>(false);
-    for (const auto& it : device_properties_) {
+    root["device_disabled_"] = device_disabled();
+    // lock free copy, never waits on PLM driven writes
+    for (const auto& it : device_state_.snapshot()) {
         properties[it.first] = it.second;
     }
     root["properties_"] = properties;
@@ -344,11 +409,13 @@ InsteonDevice::SerializeJson() {
 
 void InsteonDevice::SerializeYAML() {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
-    std::lock_guard<std::mutex>lock(property_lock_);
+    PropertyKeys properties = device_state_.snapshot();
+    std::lock_guard<std::mutex>lock(config_lock_);
     config_["device_address_"] = insteon_address();
     config_["device_name_"] = device_name();
     config_["device_disabled_"] = device_disabled();
-    for (const auto& it : device_properties_) {
+    config_["last_seen_"] = last_seen();
+    for (const auto& it : properties) {
         config_["properties_"][it.first] = it.second;
     }
 }
@@ -360,128 +427,645 @@ void InsteonDevice::SerializeYAML() {
  * - command field #2 is set to default values
  * 
  * @param command INSTEON command field #1
- * @return Returns TRUE/FALSE
+ * @return Returns TRUE if the device acknowledged the command
  */
 bool
 InsteonDevice::command(InsteonDeviceCommand command,
         uint8_t command_two) {
+    return execute(command, command_two) == InsteonCommandStatus::Ack;
+}
+
+/**
+ * Execute
+ * 
+ * Sends a command to this device and waits for the outcome.
+ * 
+ * @param command INSTEON command field #1
+ * @param command_two INSTEON command field #2
+ * @return Returns the status of the command, ie: ACK, NAK or timeout
+ */
+InsteonCommandStatus
+InsteonDevice::execute(InsteonDeviceCommand command,
+        uint8_t command_two) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    std::vector<uint8_t> send_buffer;
+    uint8_t receive_message_id = 0x50;
+    InsteonCommandStatus status = prepareCommand(command, command_two,
+            send_buffer, receive_message_id);
+    if (status != InsteonCommandStatus::Ack)
+        return status;
+    PropertyKeys properties;
+    PlmEcho echo = msgProc_->trySendReceive(send_buffer, 3,
+            receive_message_id, properties);
+    return finishCommand(command, commandStatus(echo, properties),
+            properties);
+}
+
+/**
+ * AsyncExecute
+ * 
+ * Sends a command to this device without waiting for the outcome, done is
+ * posted to the device strand with the status once the device answers or
+ * the command times out.
+ * 
+ * @param command INSTEON command field #1
+ * @param command_two INSTEON command field #2
+ * @param done receives the status of the command
+ */
+void
+InsteonDevice::asyncExecute(InsteonDeviceCommand command,
+        uint8_t command_two, CommandHandler done) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
+    std::vector<uint8_t> send_buffer;
+    uint8_t receive_message_id = 0x50;
+    InsteonCommandStatus status = prepareCommand(command, command_two,
+            send_buffer, receive_message_id);
+    if (status != InsteonCommandStatus::Ack) {
+        io_strand_.post(system::profile("InsteonDevice::asyncExecute",
+                std::bind(done, status)));
+        return;
+    }
+    msgProc_->asyncSendReceive(send_buffer, 3, receive_message_id,
+            [this, command, done](PlmEcho echo, PropertyKeys properties) {
+                InsteonCommandStatus status = finishCommand(command,
+                        commandStatus(echo, properties), properties);
+                io_strand_.post(system::profile("InsteonDevice::asyncExecute",
+                std::bind(done, status)));
+            });
+}
+
+/**
+ * Poll
+ * 
+ * Requests made while handling a message, ie: a status request after a
+ * missed cleanup, are handed to the network to queue behind client
+ * commands. They never run on the strand directly, where a storm of them
+ * would hold the strand for the length of each command.
+ * 
+ * @param command INSTEON command field #1
+ * @param command_two INSTEON command field #2
+ */
+void
+InsteonDevice::poll(InsteonDeviceCommand command, uint8_t command_two) {
+    if (on_poll_) {
+        on_poll_(insteon_address(), command, command_two);
+        return;
+    }
+    asyncExecute(command, command_two, [](InsteonCommandStatus) {
+    });
+}
+
+/**
+ * PrepareCommand
+ * 
+ * Builds the message for a command, the response it is answered with is
+ * returned in receive_message_id.
+ * 
+ * @return Ack if the message can be sent, Disabled or Invalid otherwise
+ */
+InsteonCommandStatus
+InsteonDevice::prepareCommand(InsteonDeviceCommand command,
+        uint8_t command_two, std::vector<uint8_t>& send_buffer,
+        uint8_t& receive_message_id) {
     if (device_disabled()) {
         std::ostringstream oss;
         oss << "This device {" << device_name() << "} is in a disabled state.\n"
                 "\t  Please verify the device exists and is operational.\n"
                 "\t  Command aborted!\n";
         utils::Logger::Instance().Debug(oss.str().c_str());
-        return false; // device disabled, stop here and return
+        return InsteonCommandStatus::Disabled; // device disabled, stop here
     }
+    receive_message_id = 0x50;
+    uint8_t cmd = static_cast<uint8_t> (command);
     switch (command) {
         case InsteonDeviceCommand::ExtendedGetSet:
-            device_disabled(!tryGetExtendedInformation());
+            BuildDirectExtendedMessage(send_buffer, 0x2E, 0x00);
+            receive_message_id = 0x51;
             break;
         case InsteonDeviceCommand::ALDBReadWrite:
-            device_disabled(!tryReadWriteALDB());
+            // start address 0x0000 and record count 0x00 read everything
+            BuildDirectExtendedMessage(send_buffer, 0x2F, 0x00, 0x00, 0x00,
+                    0x00, 0x00, 0x00);
             break;
         case InsteonDeviceCommand::LightStatusRequest:
-            device_disabled(!tryLightStatusRequest());
+            BuildDirectStandardMessage(send_buffer, 0x19, 0x02);
             break;
         case InsteonDeviceCommand::On:
-            device_disabled(!tryCommand(static_cast<uint8_t> (command),
-                    command_two ? command_two : 0xFF));
+            BuildDirectStandardMessage(send_buffer, cmd,
+                    command_two ? command_two : 0xFF);
             break;
         case InsteonDeviceCommand::FastOn:
-            device_disabled(!tryCommand(static_cast<uint8_t> (command), 0xFF));
+            BuildDirectStandardMessage(send_buffer, cmd, 0xFF);
             break;
         case InsteonDeviceCommand::StartDimming:
-            device_disabled(!tryCommand(static_cast<uint8_t> (command),
-                    command_two > 0 ? 0x01 : 0x00));
+            BuildDirectStandardMessage(send_buffer, cmd,
+                    command_two > 0 ? 0x01 : 0x00);
             break;
         case InsteonDeviceCommand::Off:
         case InsteonDeviceCommand::Brighten:
         case InsteonDeviceCommand::Dim:
         case InsteonDeviceCommand::FastOff:
-            device_disabled(!tryCommand(static_cast<uint8_t> (command), 0x00));
+            BuildDirectStandardMessage(send_buffer, cmd, 0x00);
             break;
+        default:
+            return InsteonCommandStatus::Invalid;
     }
-    return device_disabled();
+    return InsteonCommandStatus::Ack;
 }
 
 /**
+ * FinishCommand
+ * 
+ * Applies the response of a command to this device, shared by the blocking
+ * and the asynchronous path. A device which doesn't acknowledge is disabled.
  * 
- * @param command Insteon Command #1 field
- * @param value   Insteon Command #2 field
- * @return Success/Fail
+ * @param command the command which was sent
+ * @param status the status of the command
+ * @param properties the properties of the device response
+ * @return status
  */
-bool
-InsteonDevice::tryCommand(uint8_t command, uint8_t value) {
-    utils::Logger::Instance().Trace(FUNCTION_NAME);
-    std::vector<uint8_t> send_buffer;
-    PropertyKeys properties;
+InsteonCommandStatus
+InsteonDevice::finishCommand(InsteonDeviceCommand command,
+        InsteonCommandStatus status, PropertyKeys& properties) {
+    bool ack = status == InsteonCommandStatus::Ack;
+    switch (command) {
+        case InsteonDeviceCommand::ExtendedGetSet:
+            if (!ack) {
+                writeDeviceProperty(DeviceProperty::ButtonOnLevel, 0xFF);
+                break;
+            }
+            writeDeviceProperty(DeviceProperty::X10HouseCode,
+                    properties["data_five"]);
+            writeDeviceProperty(DeviceProperty::X10UnitCode,
+                    properties["data_six"]);
+            writeDeviceProperty(DeviceProperty::ButtonOnRampRate,
+                    properties["data_seven"] & 0x1F);
+            writeDeviceProperty(DeviceProperty::ButtonOnLevel,
+                    properties["data_eight"]);
+            writeDeviceProperty(DeviceProperty::SignalToNoiseThreshold,
+                    properties["data_nine"]);
+            break;
+        case InsteonDeviceCommand::ALDBReadWrite:
+            if (ack)
+                beginALDB();
+            else
+                finishALDB(false);
+            break;
+        case InsteonDeviceCommand::LightStatusRequest:
+            if (!ack)
+                break;
+            writeDeviceProperty(DeviceProperty::LinkDatabaseDelta,
+                    properties["command_one"]);
+            writeDeviceProperty(DeviceProperty::LightStatus,
+                    properties["command_two"]);
+            device_state_.confirmStatus(StatusSource::StatusRequest);
+            break;
+        default:
+            break;
+    }
+    device_disabled(!ack);
+    return status;
+}
 
-    BuildDirectStandardMessage(send_buffer, command, value);
-    PlmEcho status = msgProc_->trySendReceive(send_buffer, 3, 0x50, properties);
-    if ((status == PlmEcho::ACK) && (!properties.empty())) {
-        return true;
+/**
+ * CommandStatus
+ * 
+ * Maps the result of MessageProcessor::trySendReceive to a command status.
+ * An echo without a response from the device is a timeout, a response with
+ * both the ACK and broadcast flags set is a NAK from the device.
+ * 
+ * @param status The echo returned by the PLM
+ * @param properties The properties of the device response
+ * @return 
+ */
+InsteonCommandStatus
+InsteonDevice::commandStatus(PlmEcho status, PropertyKeys& properties) {
+    if (status == PlmEcho::NAK)
+        return InsteonCommandStatus::Nak;
+    if (status != PlmEcho::ACK || properties.empty())
+        return InsteonCommandStatus::Timeout;
+    if (properties["message_flags_ack"] &&
+            properties["message_flags_broadcast"])
+        return InsteonCommandStatus::Nak;
+    return InsteonCommandStatus::Ack;
+}
+
+/**
+ * BeginALDB
+ * 
+ * The device acknowledged the read of its whole all-link database, it now
+ * streams every record as an extended 0x2F message, ending with the high
+ * water mark. A read started by readALDB is already collecting records,
+ * they may arrive before the acknowledgement is handled.
+ */
+void
+InsteonDevice::beginALDB() {
+    std::lock_guard<std::mutex>lock(aldb_lock_);
+    if (!aldb_loading_) {
+        aldb_loading_ = true;
+        aldb_pending_.clear();
     }
-    return false;
+    armALDBTimer();
 }
 
-bool
-InsteonDevice::tryGetExtendedInformation() {
-    std::vector<uint8_t> send_buffer;
-    PropertyKeys properties;
-    BuildDirectExtendedMessage(send_buffer, 0x2E, 0x00);
-    PlmEcho status = msgProc_->trySendReceive(send_buffer, 3, 0x51, properties);
-    if ((status == PlmEcho::ACK) && (!properties.empty())) {
-        writeDeviceProperty("x10_house_code", properties["data_five"]);
-        writeDeviceProperty("x10_unit_code", properties["data_six"]);
-        writeDeviceProperty("button_on_ramp_rate",
-                properties["data_seven"] & 0x1F);
-        writeDeviceProperty("button_on_level", properties["data_eight"]);
-        writeDeviceProperty("signal_to_noise_threshold", properties["data_nine"]);
-        return true;
+// (re)starts the completion timeout of the read, aldb_lock_ must be held
+void
+InsteonDevice::armALDBTimer() {
+    aldb_timer_.expires_from_now(aldb_timeout_);
+    aldb_timer_.async_wait(io_strand_.wrap(
+            [this](const boost::system::error_code & ec) {
+                if (ec == boost::asio::error::operation_aborted)
+                    return;
+                finishALDB(false);
+            }));
+}
+
+/**
+ * ReadALDB
+ * 
+ * Reads the all-link database of this device into the cache.
+ * @param done invoked once the read completes or times out
+ * @param requested invoked once the device answered the read request, the
+ * records are still streaming then
+ */
+void
+InsteonDevice::readALDB(ALDBHandler done, CommandHandler requested) {
+    {
+        // collect from before the request, the first records can be handled
+        // ahead of its acknowledgement. The completion timeout starts with
+        // the acknowledgement or the first record, the request has its own.
+        std::lock_guard<std::mutex>lock(aldb_lock_);
+        aldb_done_ = done;
+        aldb_loading_ = true;
+        aldb_pending_.clear();
+    }
+    asyncExecute(InsteonDeviceCommand::ALDBReadWrite, 0x00,
+            [this, requested](InsteonCommandStatus status) {
+                // ends the read if the request was never sent, finishCommand
+                // already did for a request the device refused
+                if (status != InsteonCommandStatus::Ack)
+                    finishALDB(false);
+                if (requested)
+                    requested(status);
+            });
+}
+
+/**
+ * OnALDBRecord
+ * 
+ * Stores a record of the read in progress, the high water mark ends it.
+ * Every record pushes the completion timeout back.
+ * @param properties
+ */
+void
+InsteonDevice::onALDBRecord(PropertyKeys& properties) {
+    InsteonLinkRecord record(properties);
+    {
+        std::lock_guard<std::mutex>lock(aldb_lock_);
+        if (!aldb_loading_)
+            return;
+        if (!record.high_water_mark()) {
+            aldb_pending_[record.memory_address] = record;
+            armALDBTimer();
+            return;
+        }
+    }
+    finishALDB(true);
+}
+
+/**
+ * FinishALDB
+ * 
+ * Ends an ALDB read. A complete read replaces the cache, which is then valid
+ * for the current link_database_delta and saved with the device config.
+ * An incomplete read keeps the previous cache.
+ * 
+ * @param complete
+ */
+void
+InsteonDevice::finishALDB(bool complete) {
+    ALDBHandler done;
+    LinkDatabase updated;
+    bool replaced = false;
+    {
+        std::lock_guard<std::mutex>lock(aldb_lock_);
+        aldb_timer_.cancel();
+        bool loading = aldb_loading_;
+        aldb_loading_ = false;
+        done.swap(aldb_done_);
+        if (complete && loading) {
+            aldb_.swap(aldb_pending_);
+            updated = aldb_;
+            replaced = true;
+            uint32_t delta = 0;
+            aldb_delta_ = device_state_.get(DeviceProperty::LinkDatabaseDelta,
+                    delta) ? static_cast<int32_t> (delta) : -1;
+
+            std::lock_guard<std::mutex>config_lock(config_lock_);
+            YAML::Node records;
+            for (const auto& it : aldb_) {
+                const InsteonLinkRecord& record = it.second;
+                YAML::Node node;
+                node.push_back(record.memory_address);
+                node.push_back(static_cast<int> (record.flags));
+                node.push_back(static_cast<int> (record.group));
+                node.push_back(record.link_address);
+                node.push_back(static_cast<int> (record.data_one));
+                node.push_back(static_cast<int> (record.data_two));
+                node.push_back(static_cast<int> (record.data_three));
+                node.SetStyle(YAML::EmitterStyle::Flow);
+                records.push_back(node);
+            }
+            config_["aldb_"] = records;
+            config_["aldb_delta_"] = aldb_delta_;
+        }
+        aldb_pending_.clear();
+        utils::Logger::Instance().Debug("%s\n\t  - %s{%s} ALDB read %s, "
+                "%d records", FUNCTION_NAME_CSTR, device_name().c_str(),
+                utils::int_to_hex(insteon_address()).c_str(),
+                complete ? "complete" : "incomplete", aldb_.size());
+    }
+    if (replaced && on_aldb_update_)
+        on_aldb_update_(insteon_address(), updated);
+    if (done)
+        done(complete);
+}
+
+/**
+ * LoadALDB
+ * 
+ * Loads the ALDB cached by a previous run, see finishALDB.
+ */
+void
+InsteonDevice::loadALDB() {
+    std::lock_guard<std::mutex>lock(aldb_lock_);
+    std::lock_guard<std::mutex>config_lock(config_lock_);
+    aldb_delta_ = config_["aldb_delta_"].as<int32_t>(-1);
+    YAML::Node records = config_["aldb_"];
+    for (auto it = records.begin(); it != records.end(); ++it) {
+        const YAML::Node& node = *it;
+        if (!node.IsSequence() || node.size() != 7)
+            continue;
+        InsteonLinkRecord record;
+        record.memory_address = node[0].as<uint16_t>();
+        record.flags = node[1].as<int>();
+        record.group = node[2].as<int>();
+        record.link_address = node[3].as<uint32_t>();
+        record.data_one = node[4].as<int>();
+        record.data_two = node[5].as<int>();
+        record.data_three = node[6].as<int>();
+        aldb_[record.memory_address] = record;
     }
-    writeDeviceProperty("button_on_level", 0xFF);
-    return false;
 }
 
+/**
+ * AldbStale
+ * 
+ * @return true if the cached ALDB was read for another link_database_delta,
+ * or never read at all.
+ */
 bool
-InsteonDevice::tryLightStatusRequest() {
-    std::vector<uint8_t> send_buffer;
-    PropertyKeys properties;
-    BuildDirectStandardMessage(send_buffer, 0x19, 0x02);
-    PlmEcho status = msgProc_->trySendReceive(send_buffer, 3, 0x50, properties);
-    if ((status == PlmEcho::ACK) && (!properties.empty())) {
-        writeDeviceProperty("link_database_delta", properties["command_one"]);
-        writeDeviceProperty("light_status", properties["command_two"]);
+InsteonDevice::aldbStale() {
+    uint32_t delta = 0;
+    if (!device_state_.get(DeviceProperty::LinkDatabaseDelta, delta))
         return true;
+    std::lock_guard<std::mutex>lock(aldb_lock_);
+    return aldb_delta_ < 0 || static_cast<uint32_t> (aldb_delta_) != delta;
+}
+
+InsteonDevice::LinkDatabase
+InsteonDevice::aldb() {
+    std::lock_guard<std::mutex>lock(aldb_lock_);
+    return aldb_;
+}
+
+/**
+ * AddALDBRecord
+ * 
+ * Writes a record to the ALDB of this device, at the first unused address of
+ * the cached ALDB, or below the last record. The cache is not locked while
+ * the write is sent. The device bumps its delta for the write and the
+ * cached delta is bumped with it, so the cache stays current.
+ * 
+ * @param record its memory_address is set to the address written
+ * @return Invalid if the ALDB was never read, else the status of the write
+ */
+InsteonCommandStatus
+InsteonDevice::addALDBRecord(InsteonLinkRecord& record) {
+    if (device_disabled())
+        return InsteonCommandStatus::Disabled;
+    // one write at a time, two writes never pick the same address
+    std::lock_guard<std::mutex>write_lock(aldb_write_lock_);
+    int32_t delta = -1;
+    uint16_t address = 0x0FFF; // records grow down from the top
+    {
+        std::lock_guard<std::mutex>lock(aldb_lock_);
+        if (aldb_delta_ < 0 || aldb_loading_)
+            return InsteonCommandStatus::Invalid;
+        bool found = false;
+        for (const auto& it : aldb_) {
+            if (!it.second.in_use()) {
+                address = it.first;
+                found = true;
+                break;
+            }
+        }
+        if (!found && !aldb_.empty())
+            address = aldb_.begin()->first - 8;
+        delta = aldb_delta_;
     }
-    return false;
+    record.memory_address = address;
+    return writeALDBRecord(record, delta);
 }
 
-bool
-InsteonDevice::tryReadWriteALDB() {
+/**
+ * RemoveALDBRecord
+ * 
+ * Marks a record written by addALDBRecord unused. The record keeps bit 1 of
+ * its flags, it doesn't become the high water mark and hide the records
+ * past it.
+ * 
+ * @param record memory_address selects the record
+ * @return Invalid if the ALDB was never read, else the status of the write
+ */
+InsteonCommandStatus
+InsteonDevice::removeALDBRecord(InsteonLinkRecord record) {
+    if (device_disabled())
+        return InsteonCommandStatus::Disabled;
+    std::lock_guard<std::mutex>write_lock(aldb_write_lock_);
+    int32_t delta = -1;
+    {
+        std::lock_guard<std::mutex>lock(aldb_lock_);
+        if (aldb_delta_ < 0 || aldb_loading_)
+            return InsteonCommandStatus::Invalid;
+        delta = aldb_delta_;
+    }
+    record.flags = (record.flags & 0x7F) | 0x02;
+    return writeALDBRecord(record, delta);
+}
+
+/*
+ * Writes record at its memory_address with Write ALDB (0x2F) and updates
+ * the cache, if the cache is still at delta.
+ * must be called with aldb_write_lock_ held
+ */
+InsteonCommandStatus
+InsteonDevice::writeALDBRecord(const InsteonLinkRecord& record,
+        int32_t delta) {
     std::vector<uint8_t> send_buffer;
-    BuildDirectExtendedMessage(send_buffer, 0x2F, 0x00, 0x01, 0x0F, 0xFF,
-            0x00, 0x00);
+    uint16_t address = record.memory_address;
+    BuildDirectExtendedMessage(send_buffer, 0x2F, 0x00, 0x00, 0x02,
+            address >> 8 & 0xFF, address & 0xFF, 0x08, record.flags,
+            record.group, record.link_address >> 16 & 0xFF,
+            record.link_address >> 8 & 0xFF, record.link_address & 0xFF,
+            record.data_one, record.data_two, record.data_three);
     PropertyKeys properties;
     PlmEcho status = msgProc_->trySendReceive(send_buffer, 3, 0x50,
             properties);
-    if ((status == PlmEcho::ACK) && (!properties.empty())) {
-        return true;
+    InsteonCommandStatus result = commandStatus(status, properties);
+    if (result != InsteonCommandStatus::Ack)
+        return result;
+
+    LinkDatabase updated;
+    {
+        std::lock_guard<std::mutex>lock(aldb_lock_);
+        // a read started or finished meanwhile, the cache is its to replace
+        if (aldb_loading_ || aldb_delta_ != delta)
+            return InsteonCommandStatus::Ack;
+        aldb_[address] = record;
+        aldb_delta_ = (aldb_delta_ + 1) & 0xFF;
+        updated = aldb_;
     }
-    return false;
+    if (on_aldb_update_)
+        on_aldb_update_(insteon_address(), updated);
+    return InsteonCommandStatus::Ack;
 }
 
+/**
+ * LinkedStatus
+ * 
+ * A controller this device responds to broadcast a group command, the
+ * device went to the level of its responder record without saying so.
+ * @param level
+ * @param source Broadcast, or DirectAck once the device acknowledged the
+ * cleanup of the group command
+ */
 void
-InsteonDevice::statusUpdate(uint8_t status) {
+InsteonDevice::linkedStatus(uint8_t level, StatusSource source) {
+    io_strand_.get_io_service().post(system::profile(
+            "InsteonDevice::statusUpdate", std::bind(&type::statusUpdate,
+            this, level, source)));
+}
+
+void
+InsteonDevice::statusUpdate(uint8_t status, StatusSource source) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
     device_disabled(false);
     config_["device_disabled_"] = device_disabled();
-    writeDeviceProperty("light_status", status);
+    writeDeviceProperty(DeviceProperty::LightStatus, status);
+    device_state_.confirmStatus(source);
     if (onStatusUpdate)
         onStatusUpdate(SerializeJson());
 }
 
+/**
+ * StatusUncertain
+ * 
+ * @return true if the light status was never confirmed or is older than
+ * the configured status_ttl, a LightStatusRequest is then worth its cost.
+ */
+bool
+InsteonDevice::statusUncertain() {
+    return !device_state_.statusFresh(status_ttl_);
+}
+
+int64_t
+InsteonDevice::last_seen() {
+    return last_seen_.load(std::memory_order_relaxed);
+}
+
+void
+InsteonDevice::touch() {
+    last_seen_.store(std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count(),
+            std::memory_order_relaxed);
+}
+
+/**
+ * SnapshotRecord
+ * 
+ * Captures the runtime state of this device for the snapshot file.
+ * Steady clock times are converted to unix time so they survive a restart.
+ */
+DeviceSnapshotRecord
+InsteonDevice::snapshotRecord() {
+    DeviceSnapshotRecord record;
+    uint32_t delta = 0;
+    record.address = insteon_address();
+    record.light_status = readDeviceProperty(DeviceProperty::LightStatus, 0);
+    record.flags = device_state_.get(DeviceProperty::LinkDatabaseDelta, delta)
+            ? DeviceSnapshot::kHasDelta : 0;
+    record.link_database_delta = delta;
+    record.status_source = static_cast<uint8_t> (device_state_.statusSource());
+    record.last_seen = last_seen();
+    record.status_confirmed = 0;
+    std::chrono::steady_clock::time_point confirmed =
+            device_state_.statusConfirmed();
+    if (confirmed.time_since_epoch().count() != 0) {
+        auto age = std::chrono::steady_clock::now() - confirmed;
+        record.status_confirmed = std::chrono::duration_cast<
+                std::chrono::seconds>((std::chrono::system_clock::now() - age)
+                .time_since_epoch()).count();
+    }
+    return record;
+}
+
+/**
+ * Restore
+ * 
+ * Publishes state recorded before a restart. The status keeps its original
+ * confirmation time, it is only trusted for what is left of status_ttl.
+ * 
+ * @param record
+ */
+void
+InsteonDevice::restore(const DeviceSnapshotRecord& record) {
+    writeDeviceProperty(DeviceProperty::LightStatus, record.light_status);
+    if (record.flags & DeviceSnapshot::kHasDelta)
+        writeDeviceProperty(DeviceProperty::LinkDatabaseDelta,
+            record.link_database_delta);
+    if (record.last_seen > last_seen())
+        last_seen_.store(record.last_seen, std::memory_order_relaxed);
+    if (record.status_confirmed == 0)
+        return;
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    std::chrono::seconds age(std::max<int64_t>(0,
+            now - record.status_confirmed));
+    device_state_.confirmStatus(StatusSource::Snapshot,
+            std::chrono::steady_clock::now() - age);
+}
+
+void
+InsteonDevice::set_status_ttl(std::chrono::seconds ttl) {
+    status_ttl_ = ttl;
+}
+
+void
+InsteonDevice::set_aldb_timeout(std::chrono::milliseconds timeout) {
+    aldb_timeout_ = timeout;
+}
+
+void
+InsteonDevice::set_aldb_update_handler(ALDBUpdateHandler callback) {
+    on_aldb_update_ = callback;
+}
+
+void
+InsteonDevice::set_poll_handler(PollHandler callback) {
+    on_poll_ = callback;
+}
+
 void
 InsteonDevice::set_message_proc(
         std::shared_ptr<MessageProcessor> messenger) {
@@ -495,19 +1079,29 @@ InsteonDevice::set_update_handler(std::function<
 }
 
 void
-InsteonDevice::writeDeviceProperty(const std::string key, const uint32_t value) {
-    std::lock_guard<std::mutex>lock(property_lock_);
-    device_properties_[key] = value;
+InsteonDevice::writeDeviceProperty(const std::string& key,
+        const uint32_t value) {
+    device_state_.write(key, value);
 }
 
 uint32_t
-InsteonDevice::readDeviceProperty(const std::string key, uint32_t default_value) {
-    std::lock_guard<std::mutex>lock(property_lock_);
-    auto it = device_properties_.find(key);
-    if (it != device_properties_.end()) {
-        return it->second;
-    }
-    return default_value;
+InsteonDevice::readDeviceProperty(const std::string& key,
+        uint32_t default_value) {
+    uint32_t value = default_value;
+    device_state_.get(key, value);
+    return value;
+}
+
+void
+InsteonDevice::writeDeviceProperty(DeviceProperty property,
+        const uint32_t value) {
+    device_state_.write(property, value);
+}
+
+uint32_t
+InsteonDevice::readDeviceProperty(DeviceProperty property,
+        uint32_t default_value) {
+    return device_state_.read(property, default_value);
 }
 
 /**
@@ -525,8 +1119,8 @@ InsteonDevice::BuildDirectStandardMessage(
     send_buffer.clear();
     uint8_t max_hops = 3;
     uint8_t message_flags = 0;
-    max_hops = readDeviceProperty("message_flags_max_hops", 3) > 0
-            ? readDeviceProperty("message_flags_max_hops", 3) : max_hops;
+    max_hops = readDeviceProperty(DeviceProperty::MessageFlagsMaxHops, 3);
+    max_hops = max_hops > 0 ? max_hops : 3;
     message_flags = (max_hops << 2) | max_hops;
     send_buffer = {0x62, insteon_address_.address_high_,
         insteon_address_.address_middle_, insteon_address_.address_low_,
@@ -544,8 +1138,8 @@ InsteonDevice::BuildDirectExtendedMessage(
     send_buffer.clear();
     uint8_t max_hops = 3;
     uint8_t message_flags = 0;
-    max_hops = readDeviceProperty("message_flags_max_hops", 3) > 0
-            ? readDeviceProperty("message_flags_max_hops", 3) : max_hops;
+    max_hops = readDeviceProperty(DeviceProperty::MessageFlagsMaxHops, 3);
+    max_hops = max_hops > 0 ? max_hops : 3;
     message_flags = 16 | (max_hops << 2) | max_hops;
     send_buffer = {0x62, insteon_address_.address_high_,
         insteon_address_.address_middle_, insteon_address_.address_low_,
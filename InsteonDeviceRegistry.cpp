@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "include/insteon/InsteonDeviceRegistry.hpp"
+#include "include/insteon/InsteonDevice.hpp"
+
+#include <algorithm>
+
+namespace ace {
+namespace insteon {
+
+namespace {
+
+bool
+compare(const InsteonDeviceRegistry::entry& lhs, uint32_t rhs) {
+    return lhs.first < rhs;
+}
+
+} // namespace
+
+InsteonDeviceRegistry::InsteonDeviceRegistry()
+: table_(std::make_shared<const table>()) {
+}
+
+std::shared_ptr<InsteonDevice>
+InsteonDeviceRegistry::search(const table& devices, uint32_t key) {
+    auto it = std::lower_bound(devices.begin(), devices.end(), key, compare);
+    if (it != devices.end() && it->first == key)
+        return it->second;
+    return nullptr;
+}
+
+/**
+ * Find
+ * 
+ * Lock free lookup, safe to call while another thread inserts.
+ * @param insteon_address
+ * @return the device or an empty pointer
+ */
+std::shared_ptr<InsteonDevice>
+InsteonDeviceRegistry::find(uint32_t insteon_address) const {
+    std::shared_ptr<const table> devices = std::atomic_load(&table_);
+    return search(*devices, key(insteon_address));
+}
+
+/**
+ * Insert
+ * 
+ * Returns the existing device or creates, stores and returns a new one.
+ * @param insteon_address
+ * @param create invoked only when the address is not registered yet
+ * @return the registered device
+ */
+std::shared_ptr<InsteonDevice>
+InsteonDeviceRegistry::insert(uint32_t insteon_address,
+        const factory& create) {
+    uint32_t address = key(insteon_address);
+    std::lock_guard<std::mutex>lock(insert_lock_);
+    std::shared_ptr<const table> current = std::atomic_load(&table_);
+    std::shared_ptr<InsteonDevice> device = search(*current, address);
+    if (device)
+        return device;
+
+    device = create(address);
+    std::shared_ptr<table> devices = std::make_shared<table>();
+    devices->reserve(current->size() + 1);
+    auto it = std::lower_bound(current->begin(), current->end(), address,
+            compare);
+    devices->insert(devices->end(), current->begin(), it);
+    devices->emplace_back(address, device);
+    devices->insert(devices->end(), it, current->end());
+    std::atomic_store(&table_, std::shared_ptr<const table>(
+            std::move(devices)));
+    return device;
+}
+
+/**
+ * Snapshot
+ * 
+ * An immutable view of every device, sorted by address, for iteration.
+ */
+std::shared_ptr<const InsteonDeviceRegistry::table>
+InsteonDeviceRegistry::snapshot() const {
+    return std::atomic_load(&table_);
+}
+
+std::size_t
+InsteonDeviceRegistry::size() const {
+    return std::atomic_load(&table_)->size();
+}
+
+} // namespace insteon
+} // namespace ace
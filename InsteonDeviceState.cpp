@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "include/insteon/InsteonDeviceState.hpp"
+
+#include <algorithm>
+
+namespace ace {
+namespace insteon {
+
+namespace {
+
+struct PropertyName {
+    const char* name;
+    DeviceProperty property;
+};
+
+// sorted by name for binary search
+const PropertyName property_names[] = {
+    {"button_on_level", DeviceProperty::ButtonOnLevel},
+    {"button_on_ramp_rate", DeviceProperty::ButtonOnRampRate},
+    {"device_category", DeviceProperty::DeviceCategory},
+    {"device_engine_version", DeviceProperty::DeviceEngineVersion},
+    {"device_firmware_version", DeviceProperty::DeviceFirmwareVersion},
+    {"device_subcategory", DeviceProperty::DeviceSubcategory},
+    {"enable_blink_on_traffic", DeviceProperty::EnableBlinkOnTraffic},
+    {"enable_led", DeviceProperty::EnableLed},
+    {"enable_load_sense", DeviceProperty::EnableLoadSense},
+    {"enable_programming_lock", DeviceProperty::EnableProgrammingLock},
+    {"enable_resume_dim", DeviceProperty::EnableResumeDim},
+    {"light_status", DeviceProperty::LightStatus},
+    {"link_database_delta", DeviceProperty::LinkDatabaseDelta},
+    {"message_flags_max_hops", DeviceProperty::MessageFlagsMaxHops},
+    {"signal_to_noise_threshold", DeviceProperty::SignalToNoiseThreshold},
+    {"x10_house_code", DeviceProperty::X10HouseCode},
+    {"x10_unit_code", DeviceProperty::X10UnitCode},
+};
+
+static_assert(sizeof (property_names) / sizeof (property_names[0]) ==
+        static_cast<std::size_t> (DeviceProperty::Count),
+        "every DeviceProperty requires a name");
+
+} // namespace
+
+InsteonDeviceState::InsteonDeviceState() : present_(0), status_confirmed_(0),
+status_source_(static_cast<uint8_t> (StatusSource::Unknown)) {
+    for (auto& it : values_)
+        it.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Lookup
+ * 
+ * Maps a property name to its fixed slot.
+ * @param key property name, ie: light_status
+ * @param property receives the slot
+ * @return false if the key is not part of the fixed schema
+ */
+bool
+InsteonDeviceState::lookup(const std::string& key, DeviceProperty& property) {
+    auto end = std::end(property_names);
+    auto it = std::lower_bound(std::begin(property_names), end, key,
+            [](const PropertyName& lhs, const std::string& rhs) {
+                return rhs.compare(lhs.name) > 0;
+            });
+    if (it == end || key.compare(it->name) != 0)
+        return false;
+    property = it->property;
+    return true;
+}
+
+const char*
+InsteonDeviceState::name(DeviceProperty property) {
+    for (const auto& it : property_names) {
+        if (it.property == property)
+            return it.name;
+    }
+    return "";
+}
+
+bool
+InsteonDeviceState::get(DeviceProperty property, uint32_t& value) const {
+    std::size_t index = static_cast<std::size_t> (property);
+    if (!(present_.load(std::memory_order_acquire) & (1u << index)))
+        return false;
+    value = values_[index].load(std::memory_order_relaxed);
+    return true;
+}
+
+uint32_t
+InsteonDeviceState::read(DeviceProperty property,
+        uint32_t default_value) const {
+    uint32_t value = default_value;
+    get(property, value);
+    return value;
+}
+
+void
+InsteonDeviceState::write(DeviceProperty property, uint32_t value) {
+    std::size_t index = static_cast<std::size_t> (property);
+    values_[index].store(value, std::memory_order_relaxed);
+    // publishes the value to readers which observe the presence bit
+    present_.fetch_or(1u << index, std::memory_order_release);
+}
+
+bool
+InsteonDeviceState::get(const std::string& key, uint32_t& value) const {
+    DeviceProperty property;
+    if (lookup(key, property))
+        return get(property, value);
+    std::lock_guard<std::mutex>lock(custom_lock_);
+    auto it = custom_.find(key);
+    if (it == custom_.end())
+        return false;
+    value = it->second;
+    return true;
+}
+
+void
+InsteonDeviceState::write(const std::string& key, uint32_t value) {
+    DeviceProperty property;
+    if (lookup(key, property))
+        return write(property, value);
+    std::lock_guard<std::mutex>lock(custom_lock_);
+    custom_[key] = value;
+}
+
+PropertyKeys
+InsteonDeviceState::snapshot() const {
+    PropertyKeys properties;
+    uint32_t present = present_.load(std::memory_order_acquire);
+    for (const auto& it : property_names) {
+        std::size_t index = static_cast<std::size_t> (it.property);
+        if (present & (1u << index))
+            properties[it.name] = values_[index].load(
+                std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex>lock(custom_lock_);
+    properties.insert(custom_.begin(), custom_.end());
+    return properties;
+}
+
+/**
+ * ConfirmStatus
+ * 
+ * Records that the light status is known to be current, and how.
+ * @param source
+ */
+void
+InsteonDeviceState::confirmStatus(StatusSource source) {
+    confirmStatus(source, std::chrono::steady_clock::now());
+}
+
+void
+InsteonDeviceState::confirmStatus(StatusSource source,
+        std::chrono::steady_clock::time_point when) {
+    status_source_.store(static_cast<uint8_t> (source),
+            std::memory_order_relaxed);
+    status_confirmed_.store(when.time_since_epoch().count(),
+            std::memory_order_release);
+}
+
+std::chrono::steady_clock::time_point
+InsteonDeviceState::statusConfirmed() const {
+    return std::chrono::steady_clock::time_point{
+        std::chrono::steady_clock::duration(
+                status_confirmed_.load(std::memory_order_acquire))};
+}
+
+StatusSource
+InsteonDeviceState::statusSource() const {
+    return static_cast<StatusSource> (status_source_.load(
+            std::memory_order_relaxed));
+}
+
+/**
+ * StatusFresh
+ * 
+ * @param ttl how long a confirmed status is trusted
+ * @return true if the status was confirmed within ttl
+ */
+bool
+InsteonDeviceState::statusFresh(
+        std::chrono::steady_clock::duration ttl) const {
+    int64_t confirmed = status_confirmed_.load(std::memory_order_acquire);
+    if (confirmed == 0)
+        return false;
+    std::chrono::steady_clock::time_point when{
+        std::chrono::steady_clock::duration(confirmed)};
+    return std::chrono::steady_clock::now() - when < ttl;
+}
+
+} // namespace insteon
+} // namespace ace
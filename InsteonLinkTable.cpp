@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "include/insteon/InsteonLinkTable.hpp"
+
+#include <tuple>
+
+namespace ace {
+namespace insteon {
+
+InsteonLinkTable::InsteonLinkTable()
+: index_(std::make_shared<const index>()) {
+}
+
+/**
+ * Update
+ * 
+ * Replaces the links found in the database of one device or the PLM and
+ * publishes new indexes. A link seen from both ends is kept once, with the
+ * responder's on level and ramp rate.
+ * 
+ * @param owner address of the device the records were read from
+ * @param records
+ */
+void
+InsteonLinkTable::update(uint32_t owner,
+        const std::vector<InsteonLinkRecord>& records) {
+    links found = collect(owner, records);
+    std::lock_guard<std::mutex>lock(update_lock_);
+    owners_[owner & 0xFFFFFF].swap(found);
+    rebuild();
+}
+
+/**
+ * Stage
+ * 
+ * Like update, but the links are only published by the next publish or
+ * update. Loading N databases this way rebuilds the indexes once, not N
+ * times.
+ * 
+ * @param owner
+ * @param records
+ */
+void
+InsteonLinkTable::stage(uint32_t owner,
+        const std::vector<InsteonLinkRecord>& records) {
+    links found = collect(owner, records);
+    std::lock_guard<std::mutex>lock(update_lock_);
+    owners_[owner & 0xFFFFFF].swap(found);
+}
+
+/**
+ * Publish
+ * 
+ * Rebuilds the indexes from every database staged or updated so far.
+ */
+void
+InsteonLinkTable::publish() {
+    std::lock_guard<std::mutex>lock(update_lock_);
+    rebuild();
+}
+
+InsteonLinkTable::links
+InsteonLinkTable::collect(uint32_t owner,
+        const std::vector<InsteonLinkRecord>& records) {
+    owner &= 0xFFFFFF;
+    links found;
+    for (const auto& record : records) {
+        if (!record.in_use())
+            continue;
+        if (record.controller())
+            found.push_back({owner, record.group, record.link_address,
+                0, 0, false});
+        else
+            found.push_back({record.link_address, record.group, owner,
+                record.data_one, record.data_two, true});
+    }
+    return found;
+}
+
+// must be called with update_lock_ held
+void
+InsteonLinkTable::rebuild() {
+    std::map<std::tuple<uint32_t, uint8_t, uint32_t>, InsteonLink> merged;
+    for (const auto& it : owners_) {
+        for (const auto& link : it.second) {
+            auto result = merged.emplace(std::make_tuple(link.controller,
+                    link.group, link.responder), link);
+            if (!result.second && link.level_known)
+                result.first->second = link;
+        }
+    }
+
+    std::shared_ptr<index> indexes = std::make_shared<index>();
+    for (const auto& it : merged) {
+        const InsteonLink& link = it.second;
+        indexes->groups[key(link.controller, link.group)].push_back(link);
+        indexes->responders[link.responder].push_back(link);
+    }
+    indexes->size = merged.size();
+    std::atomic_store(&index_, std::shared_ptr<const index>(
+            std::move(indexes)));
+}
+
+/**
+ * Responders
+ * 
+ * @param controller
+ * @param group
+ * @return every device that responds to the group of the controller
+ */
+InsteonLinkTable::links
+InsteonLinkTable::responders(uint32_t controller, uint8_t group) const {
+    std::shared_ptr<const index> indexes = std::atomic_load(&index_);
+    auto it = indexes->groups.find(key(controller, group));
+    return it != indexes->groups.end() ? it->second : links();
+}
+
+/**
+ * Controllers
+ * 
+ * @param responder
+ * @return every controller and group the device responds to
+ */
+InsteonLinkTable::links
+InsteonLinkTable::controllers(uint32_t responder) const {
+    std::shared_ptr<const index> indexes = std::atomic_load(&index_);
+    auto it = indexes->responders.find(responder & 0xFFFFFF);
+    return it != indexes->responders.end() ? it->second : links();
+}
+
+std::size_t
+InsteonLinkTable::size() const {
+    return std::atomic_load(&index_)->size;
+}
+
+} // namespace insteon
+} // namespace ace
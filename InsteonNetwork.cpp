@@ -31,9 +31,11 @@
 
 #include "include/json/json.h"
 #include "include/Logger.h"
+#include "include/system/HandlerProfiler.hpp"
 #include "include/utils/utils.hpp"
 
 #include <iostream>
+#include <algorithm>
 
 #include <mutex>
 #include <condition_variable>
@@ -44,18 +46,27 @@ namespace insteon
 {
 
 InsteonNetwork::InsteonNetwork(boost::asio::io_service& io_service,
-        YAML::Node config)
-: io_service_(io_service), io_strand_(io_service), config_(config),
-msg_proc_(new MessageProcessor(io_service, config["PLM"])) {
+        boost::asio::io_service& plm_io_service, YAML::Node config)
+: io_service_(io_service), io_strand_(io_service), command_queue_(io_strand_),
+scene_active_(false), scene_command_(0),
+msg_proc_(new MessageProcessor(io_service, plm_io_service, config["PLM"])),
+sync_timer_(io_service), sync_index_(0), sync_completed_(0), sync_failed_(0),
+sync_skipped_(0), snapshot_timer_(io_service), config_(config) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
     msg_proc_->set_message_handler(std::bind(&type::onMessage, this,
             std::placeholders::_1));
     insteon_controller_ = std::move(std::unique_ptr<InsteonController>(
             new InsteonController(this, io_service)));
+    provisioner_.configure(
+            config_["PLM"]["group_suggestion_threshold"].as<unsigned>(3),
+            std::chrono::milliseconds(
+            config_["PLM"]["group_suggestion_window"].as<int>(2000)));
 }
 
 InsteonNetwork::~InsteonNetwork() {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
+    sync_timer_.cancel();
+    snapshot_timer_.cancel();
 }
 
 /**
@@ -73,21 +84,30 @@ std::shared_ptr<InsteonDevice>
 InsteonNetwork::addDevice(uint32_t insteon_address) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
 
-    auto it = device_map_.find(insteon_address);
-    if (it != device_map_.end())
-        return it->second;
-
-    std::shared_ptr<InsteonDevice> device = std::make_shared<InsteonDevice>
-            (insteon_address, io_strand_, config_
-            ["DEVICES"][ace::utils::int_to_hex(insteon_address)]);
-
-    device->set_message_proc(msg_proc_);
-    device->set_update_handler(std::bind(&type::onUpdateDevice,
-            this, std::placeholders::_1));
-
-    return device_map_.insert(InsteonDeviceMapPair(insteon_address, device))
-            .first->second;
+    return device_registry_.insert(insteon_address, [this](uint32_t address) {
+        std::shared_ptr<InsteonDevice> device = std::make_shared<InsteonDevice>
+                (address, io_strand_, config_
+                ["DEVICES"][ace::utils::int_to_hex(address)]);
 
+        device->set_message_proc(msg_proc_);
+        device->set_status_ttl(std::chrono::seconds(
+                config_["PLM"]["status_ttl"].as<int>(600)));
+        device->set_aldb_timeout(std::chrono::milliseconds(
+                config_["PLM"]["aldb_timeout"].as<int>(5000)));
+        device->set_update_handler(std::bind(&type::onUpdateDevice,
+                this, std::placeholders::_1));
+        device->set_aldb_update_handler(std::bind(&type::onDeviceALDB,
+                this, std::placeholders::_1, std::placeholders::_2));
+        device->set_poll_handler(std::bind(&type::pollDevice, this,
+                std::placeholders::_1, std::placeholders::_2,
+                std::placeholders::_3));
+        // cached by a previous run, published once the devices are loaded
+        std::vector<InsteonLinkRecord> records;
+        for (const auto& it : device->aldb())
+            records.push_back(it.second);
+        link_table_.stage(address, records);
+        return device;
+    });
 }
 
 /**
@@ -101,15 +121,78 @@ InsteonNetwork::loadDevices() {
     for (auto it = device.begin(); it != device.end(); ++it) {
         addDevice(it->first.as<int>(0));
     }
+    link_table_.publish();
+
+    // publish the state known before the restart, the startup sync only
+    // revalidates what the snapshot can't vouch for
+    snapshot_file_ = config_["snapshot_file"].as<std::string>(
+            "/var/tmp/autohubpp.snapshot");
+    if (snapshot_file_.empty())
+        return;
+    std::size_t restored = 0;
+    DeviceSnapshot::load(snapshot_file_,
+            [this, &restored](const DeviceSnapshotRecord & record) {
+                std::shared_ptr<InsteonDevice> device = getDevice(
+                        record.address);
+                if (!device)
+                    return;
+                device->restore(record);
+                restored++;
+            });
+    utils::Logger::Instance().Info("%s\n\t  - restored %d devices from %s",
+            FUNCTION_NAME_CSTR, restored, snapshot_file_.c_str());
 }
 
 void
 InsteonNetwork::saveDevices() {
-    utils::Logger::Instance().Debug("%s\n\t  - %d devices total",
-            FUNCTION_NAME_CSTR, device_map_.size());
-    for (const auto& it : device_map_) {
+    utils::Logger::Instance().Debug("%s\n\t  - %zu devices total",
+            FUNCTION_NAME_CSTR, device_registry_.size());
+    for (const auto& it : *device_registry_.snapshot()) {
         it.second->SerializeYAML();
     }
+    snapshot_timer_.cancel();
+    writeSnapshot();
+}
+
+/**
+ * WriteSnapshot
+ * 
+ * Writes the runtime state of every device to snapshot_file.
+ */
+void
+InsteonNetwork::writeSnapshot() {
+    if (snapshot_file_.empty())
+        return;
+    std::vector<DeviceSnapshotRecord> records;
+    std::shared_ptr<const InsteonDeviceRegistry::table> devices =
+            device_registry_.snapshot();
+    records.reserve(devices->size());
+    for (const auto& it : *devices)
+        records.push_back(it.second->snapshotRecord());
+
+    std::lock_guard<std::mutex>lock(snapshot_lock_);
+    if (!DeviceSnapshot::write(snapshot_file_, records))
+        utils::Logger::Instance().Warning("%s\n\t  - unable to write %s",
+            FUNCTION_NAME_CSTR, snapshot_file_.c_str());
+}
+
+/**
+ * ScheduleSnapshot
+ * 
+ * Writes the snapshot every snapshot_interval seconds.
+ */
+void
+InsteonNetwork::scheduleSnapshot() {
+    int interval = config_["snapshot_interval"].as<int>(60);
+    if (snapshot_file_.empty() || interval <= 0)
+        return;
+    snapshot_timer_.expires_from_now(std::chrono::seconds(interval));
+    snapshot_timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted)
+            return;
+        writeSnapshot();
+        scheduleSnapshot();
+    });
 }
 
 bool
@@ -121,50 +204,186 @@ InsteonNetwork::connect() {
         return false;
     }
     if (!properties.empty()){
+        // the PLM is the controller of its own groups in the link table
+        insteon_controller_->setAddress(properties["address"]);
         // TODO: HANDLE PLM Properties
     }
 
     loadDevices();
+    scheduleSnapshot();
 
-    // start loading the ALDB from PLM
+    // load the ALDB from PLM, a PLM that stops answering can not hold up
+    // the startup for longer than database_timeout
     if (config_["PLM"]["load_aldb"].as<bool>(false)) {
         utils::Logger::Instance().Info("%s\n\t  - getting aldb from PLM",
                 FUNCTION_NAME_CSTR);
-        insteon_controller_->getDatabaseRecords(0x1F, 0xF8);
+        insteon_controller_->loadDatabase();
+        insteon_controller_->waitForDatabase(std::chrono::milliseconds(
+                config_["PLM"]["database_timeout"].as<int>(30000)));
     }
 
-    // wait here until the database is loaded
-    std::unique_lock<std::mutex> lk(mx_load_db_);
-    cv_load_db_.wait(lk, [this] {
-        return insteon_controller_->is_loading_database_ == false;
-    });
+    // get aldb and status of known devices in the background, the network
+    // accepts commands right away
+    startDeviceSync();
+    return true;
+}
 
-    // get aldb from each enabled device in the list
-    if (config_["PLM"]["load_aldb"].as<bool>(false)) {
-        utils::Logger::Instance().Info("%s\n\t  - getting aldb from known devices",
-                FUNCTION_NAME_CSTR);
-        for (const auto& it : device_map_) {
-            if (!config_["DEVICES"][utils::int_to_hex(it.second->insteon_address())]
-                    ["device_disabled_"].as<bool>(false)) {
-                io_strand_.post(std::bind(&InsteonDevice::command, it.second,
-                        InsteonDeviceCommand::ALDBReadWrite, 0x00));
-            }
+/**
+ * StartDeviceSync
+ * 
+ * Orders known devices, most recently heard from first and disabled devices
+ * last, then syncs them one at a time through the Sync lane of the command
+ * queue. Interactive commands always run ahead of the sync.
+ */
+void
+InsteonNetwork::startDeviceSync() {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    if (!config_["PLM"]["sync_device_status"].as<bool>(true))
+        return;
+
+    sync_devices_.clear();
+    for (const auto& it : *device_registry_.snapshot())
+        sync_devices_.push_back(it.second);
+    std::stable_sort(sync_devices_.begin(), sync_devices_.end(),
+            [](const std::shared_ptr<InsteonDevice>& lhs,
+            const std::shared_ptr<InsteonDevice>& rhs) {
+                if (lhs->device_disabled() != rhs->device_disabled())
+                    return rhs->device_disabled();
+                return lhs->last_seen() > rhs->last_seen();
+            });
+
+    sync_index_ = sync_completed_ = sync_failed_ = sync_skipped_ = 0;
+    sync_interval_min_ = std::chrono::milliseconds(
+            config_["PLM"]["sync_interval_min"].as<int>(50));
+    sync_interval_max_ = std::chrono::milliseconds(
+            config_["PLM"]["sync_interval_max"].as<int>(5000));
+    sync_interval_ = sync_interval_min_;
+    sync_started_ = std::chrono::steady_clock::now();
+
+    utils::Logger::Instance().Info("%s\n\t  - syncing %zu devices",
+            FUNCTION_NAME_CSTR, sync_devices_.size());
+    syncNext();
+}
+
+/**
+ * SyncNext
+ * 
+ * Queues the next device which needs syncing, disabled devices and devices
+ * whose status is still fresh are skipped without touching the PLM.
+ */
+void
+InsteonNetwork::syncNext() {
+    while (sync_index_ < sync_devices_.size()) {
+        std::shared_ptr<InsteonDevice> device = sync_devices_[sync_index_++];
+        if (device->device_disabled() || !device->statusUncertain()) {
+            sync_skipped_++;
+            continue;
         }
+        syncDevice(device);
+        return;
     }
+    utils::Logger::Instance().Info("%s\n\t  - device sync finished in %lld ms"
+            "\n\t  - completed: %zu failed: %zu skipped: %zu", FUNCTION_NAME_CSTR,
+            (long long) std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - sync_started_).count(),
+            sync_completed_, sync_failed_, sync_skipped_);
+    syncProgress(0, InsteonCommandStatus::Ack);
+    sync_devices_.clear();
+}
 
-    // get status of each enabled device in the list
-    if (config_["PLM"]["sync_device_status"].as<bool>(true)) {
-        utils::Logger::Instance().Info("%s\n\t  - syncing device status",
-                FUNCTION_NAME_CSTR);
-        for (const auto& it : device_map_) {
-            if (!config_["DEVICES"][utils::int_to_hex(it.second->insteon_address())]
-                    ["device_disabled_"].as<bool>(false)) {
-                io_strand_.post(std::bind(&InsteonDevice::command, it.second,
-                        InsteonDeviceCommand::LightStatusRequest, 0x02));
-            }
-        }
+/**
+ * SyncDevice
+ * 
+ * Runs as a Sync sequence. The status request also returns the link
+ * database delta, the ALDB is only read again when it no longer matches the
+ * delta of the cached copy.
+ * 
+ * @param device
+ */
+void
+InsteonNetwork::syncDevice(std::shared_ptr<InsteonDevice> device) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    bool load_aldb = config_["PLM"]["load_aldb"].as<bool>(false);
+    sequence(CommandPriority::Sync)
+            ->then(device, InsteonDeviceCommand::LightStatusRequest, 0x02)
+            ->then([this, device, load_aldb](CommandSequence::handler next) {
+                if (!load_aldb || !device->aldbStale()) {
+                    next(InsteonCommandStatus::Ack);
+                    return;
+                }
+                // the request holds the queue, the records streaming in
+                // don't, the next device waits until they are done
+                command_queue_.postAsync(CommandPriority::Sync, [device,
+                        next](std::function<void() > release) {
+                    device->readALDB([next](bool complete) {
+                        next(complete ? InsteonCommandStatus::Ack
+                                : InsteonCommandStatus::Timeout);
+                    }, [release](InsteonCommandStatus) {
+                        release();
+                    });
+                });
+            })
+            ->start(std::bind(&type::syncFinished, this, device,
+            std::placeholders::_1));
+}
+
+/**
+ * SyncFinished
+ * 
+ * The pause before the next device adapts to the network, it halves after
+ * a success and doubles after a failure, within sync_interval_min and
+ * sync_interval_max.
+ * 
+ * @param device
+ * @param status
+ */
+void
+InsteonNetwork::syncFinished(std::shared_ptr<InsteonDevice> device,
+        InsteonCommandStatus status) {
+    if (status == InsteonCommandStatus::Ack) {
+        sync_completed_++;
+        sync_interval_ = std::max(sync_interval_min_, sync_interval_ / 2);
+    } else {
+        sync_failed_++;
+        sync_interval_ = std::min(sync_interval_max_, sync_interval_ * 2);
     }
-    return true;
+    syncProgress(device->insteon_address(), status);
+
+    sync_timer_.expires_from_now(sync_interval_);
+    sync_timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted)
+            return;
+        syncNext();
+    });
+}
+
+/**
+ * SyncProgress
+ * 
+ * Publishes a syncProgress event, a device_id of zero marks the end.
+ * @param device_id
+ * @param status
+ */
+void
+InsteonNetwork::syncProgress(uint32_t device_id, InsteonCommandStatus status) {
+    if (!on_sync_progress)
+        return;
+    Json::Value json;
+    json["event"] = "syncProgress";
+    json["total"] = Json::UInt64(sync_devices_.size());
+    json["completed"] = Json::UInt64(sync_completed_);
+    json["failed"] = Json::UInt64(sync_failed_);
+    json["skipped"] = Json::UInt64(sync_skipped_);
+    json["elapsed_ms"] = Json::Int64(std::chrono::duration_cast<
+            std::chrono::milliseconds>(std::chrono::steady_clock::now()
+            - sync_started_).count());
+    json["done"] = device_id == 0;
+    if (device_id) {
+        json["device_id"] = device_id;
+        json["status"] = to_string(status);
+    }
+    io_service_.post(system::profile("InsteonNetwork::syncProgress",
+            [this, json]{on_sync_progress(json);}));
 }
 
 /**
@@ -178,9 +397,7 @@ InsteonNetwork::connect() {
  */
 bool
 InsteonNetwork::deviceExists(uint32_t insteon_address) {
-    utils::Logger::Instance().Trace(FUNCTION_NAME);
-    auto it = device_map_.find(insteon_address);
-    return it != device_map_.end();
+    return device_registry_.find(insteon_address) != nullptr;
 }
 
 /**
@@ -193,12 +410,7 @@ InsteonNetwork::deviceExists(uint32_t insteon_address) {
  */
 std::shared_ptr<InsteonDevice>
 InsteonNetwork::getDevice(uint32_t insteon_address) {
-    utils::Logger::Instance().Trace(FUNCTION_NAME);
-    std::shared_ptr<InsteonDevice>device;
-    auto it = device_map_.find(insteon_address);
-    if (it != device_map_.end())
-        return it->second;
-    return device;
+    return device_registry_.find(insteon_address);
 }
 
 /**
@@ -215,7 +427,7 @@ InsteonNetwork::serializeJson(uint32_t device_id) {
     Json::Value root;
     if (device_id == 0) {
         Json::Value devices;
-        for (const auto& it : device_map_) {
+        for (const auto& it : *device_registry_.snapshot()) {
             devices.append(it.second->SerializeJson());
         }
         root["devices"] = devices;
@@ -227,32 +439,452 @@ InsteonNetwork::serializeJson(uint32_t device_id) {
     return root;
 }
 
+/**
+ * InternalReceiveCommand
+ * 
+ * Receives a single device command, already parsed and validated by autohub.
+ * The command is queued in the Interactive lane, ahead of background work.
+ * When the command carries a request_id its outcome is reported back.
+ * 
+ * @param origin
+ */
 void
-InsteonNetwork::internalReceiveCommand(std::string json) {
+InsteonNetwork::internalReceiveCommand(InsteonCommand origin) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
-    Json::Reader reader;
-    Json::Value root;
-    std::string command;
-    uint8_t command_two = 0x00;
+    time_point received = std::chrono::steady_clock::now();
+    std::shared_ptr<InsteonDevice> device = getDevice(origin.device_id);
+    ResolvedCommand resolved;
+    resolved.device = device;
+    if (!device || !device->resolveCommand(origin.command,
+            origin.command_two, resolved.command, resolved.command_two)) {
+        utils::Logger::Instance().Warning("%s\n\t  - unknown device or "
+                "command: %s %s", FUNCTION_NAME_CSTR,
+                utils::int_to_hex(origin.device_id).c_str(),
+                origin.command.c_str());
+        if (origin.request_id.empty())
+            return;
+        Json::Value result;
+        result["event"] = "commandResult";
+        result["request_id"] = origin.request_id;
+        result["device_id"] = origin.device_id;
+        result["command"] = origin.command;
+        result["status"] = to_string(InsteonCommandStatus::Invalid);
+        result["latency_ms"] = 0;
+        onCommandResult(origin.session_id, result);
+        return;
+    }
+    GroupProvisioner::device_set suggestion;
+    if (SceneEngine::groupable(resolved.command) &&
+            provisioner_.observeCommand(device->insteon_address(), received,
+            suggestion))
+        suggestGroup(suggestion);
+    if (origin.request_id.empty()) {
+        sequence(CommandPriority::Interactive)
+                ->then(device, resolved.command, resolved.command_two)
+                ->start(nullptr);
+        return;
+    }
+    // the client asked for a result
+    executeCommand(resolved, std::move(origin), received);
+}
 
-    reader.parse(json, root);
+/**
+ * ExecuteCommand
+ * 
+ * Queues a single command which carries a request_id, its outcome is
+ * reported once the device answers.
+ * 
+ * @param command the resolved command
+ * @param origin the command as received from the client
+ * @param received when the command was received, used to compute latency
+ */
+void
+InsteonNetwork::executeCommand(ResolvedCommand command, InsteonCommand origin,
+        time_point received) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    sequence(CommandPriority::Interactive)
+            ->then(command.device, command.command, command.command_two)
+            ->start(std::bind(&type::commandFinished, this, std::move(origin),
+            received, std::placeholders::_1));
+}
 
-    std::shared_ptr<InsteonDevice>device;
-    std::string device_id;
-    device_id = root.get("device_id", "").asString();
+void
+InsteonNetwork::commandFinished(InsteonCommand origin, time_point received,
+        InsteonCommandStatus status) {
+    Json::Value result;
+    result["event"] = "commandResult";
+    result["request_id"] = origin.request_id;
+    result["device_id"] = origin.device_id;
+    result["command"] = origin.command;
+    result["status"] = to_string(status);
+    result["latency_ms"] = Json::Int64(std::chrono::duration_cast<
+            std::chrono::milliseconds>(std::chrono::steady_clock::now()
+            - received).count());
+    onCommandResult(origin.session_id, result);
+}
 
-    command = root.get("command", "").asString();
-    command_two = root.get("command_two", 0).asInt() <= 0 ? 0x00 :
-            root.get("command_two", 0).asInt() >= 255 ? 0xFF :
-            root.get("command_two", 0).asInt();
-    
-    device = getDevice(std::stoi(device_id));
-    if (device) {
-        device->internalReceiveCommand(command, command_two);
-    } else {
-        utils::Logger::Instance().Warning("Received command for device that"
-                " doesn't exist.");
+/**
+ * InternalReceiveBatch
+ * 
+ * Receives a set of device commands as a single unit, ie: a scene.
+ * Commands are resolved once, unknown devices and commands are dropped.
+ * Unless the batch is ordered, commands sharing the same INSTEON command
+ * are placed next to each other so they go out back to back.
+ * The whole batch executes as one Interactive job of the command queue.
+ * 
+ * @param batch
+ */
+void
+InsteonNetwork::internalReceiveBatch(InsteonCommandBatch batch) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    time_point received = std::chrono::steady_clock::now();
+    std::vector<ResolvedCommand> commands;
+    Json::Value results(Json::arrayValue);
+    commands.reserve(batch.commands.size());
+    for (const auto& it : batch.commands) {
+        ResolvedCommand resolved;
+        resolved.device = getDevice(it.device_id);
+        if (!resolved.device) {
+            utils::Logger::Instance().Warning("%s\n\t  - batch command for "
+                    "device that doesn't exist: %s", FUNCTION_NAME_CSTR,
+                    utils::int_to_hex(it.device_id).c_str());
+        } else if (!resolved.device->resolveCommand(it.command, it.command_two,
+                resolved.command, resolved.command_two)) {
+            utils::Logger::Instance().Warning("%s\n\t  - unknown batch "
+                    "command: %s", FUNCTION_NAME_CSTR, it.command.c_str());
+        } else {
+            resolved.name = it.command;
+            commands.push_back(std::move(resolved));
+            continue;
+        }
+        Json::Value result;
+        result["device_id"] = it.device_id;
+        result["command"] = it.command;
+        result["status"] = to_string(InsteonCommandStatus::Invalid);
+        results.append(result);
     }
+    if (commands.empty()) {
+        if (!batch.request_id.empty()) {
+            Json::Value json;
+            json["event"] = "commandResult";
+            json["request_id"] = batch.request_id;
+            json["results"] = results;
+            json["latency_ms"] = 0;
+            onCommandResult(batch.session_id, json);
+        }
+        return;
+    }
+
+    GroupProvisioner::device_set devices;
+    for (const auto& it : commands) {
+        if (SceneEngine::groupable(it.command))
+            devices.push_back(it.device->insteon_address());
+    }
+    GroupProvisioner::device_set suggestion;
+    if (provisioner_.observe(std::move(devices), suggestion))
+        suggestGroup(suggestion);
+
+    if (!batch.ordered) {
+        std::stable_sort(commands.begin(), commands.end(),
+                [](const ResolvedCommand& lhs, const ResolvedCommand& rhs) {
+                    if (lhs.command != rhs.command)
+                        return lhs.command < rhs.command;
+                    return lhs.command_two < rhs.command_two;
+                });
+    }
+    command_queue_.post(CommandPriority::Interactive,
+            std::bind(batch.ordered ? &type::executeBatch : &type::executeScene,
+            this, std::move(commands), batch.request_id, batch.session_id,
+            std::move(results), received));
+}
+
+/**
+ * ExecuteBatch
+ * 
+ * Runs resolved batch commands back to back on the network strand.
+ * When the batch carries a request_id a single commandResult is reported,
+ * holding the status of every command in the batch.
+ * 
+ * @param commands
+ * @param request_id
+ * @param session_id
+ * @param results statuses of the commands dropped while resolving
+ * @param received
+ */
+void
+InsteonNetwork::executeBatch(std::vector<ResolvedCommand> commands,
+        std::string request_id, uint32_t session_id, Json::Value results,
+        time_point received) {
+    utils::Logger::Instance().Debug("%s\n\t  - executing %zu batched commands",
+            FUNCTION_NAME_CSTR, commands.size());
+    for (const auto& it : commands) {
+        InsteonCommandStatus status = it.device->execute(it.command,
+                it.command_two);
+        if (request_id.empty())
+            continue;
+        Json::Value result;
+        result["device_id"] = it.device->insteon_address();
+        result["command"] = it.name;
+        result["status"] = to_string(status);
+        results.append(result);
+    }
+    if (request_id.empty())
+        return;
+    Json::Value json;
+    json["event"] = "commandResult";
+    json["request_id"] = request_id;
+    json["results"] = results;
+    json["latency_ms"] = Json::Int64(std::chrono::duration_cast<
+            std::chrono::milliseconds>(std::chrono::steady_clock::now()
+            - received).count());
+    onCommandResult(session_id, json);
+}
+
+/**
+ * ExecuteScene
+ * 
+ * Runs an unordered batch. Targets covered by PLM groups, see SceneEngine,
+ * are driven by one group broadcast per group. Responders that don't
+ * acknowledge the cleanup of the broadcast, and targets no group covers,
+ * get direct commands. Reports like executeBatch.
+ * 
+ * @param commands
+ * @param request_id
+ * @param session_id
+ * @param results statuses of the commands dropped while resolving
+ * @param received
+ */
+void
+InsteonNetwork::executeScene(std::vector<ResolvedCommand> commands,
+        std::string request_id, uint32_t session_id, Json::Value results,
+        time_point received) {
+    std::vector<SceneTarget> targets;
+    targets.reserve(commands.size());
+    for (const auto& it : commands)
+        targets.push_back({it.device->insteon_address(), it.command,
+            it.command_two});
+    ScenePlan plan;
+    if (config_["PLM"]["scene_groups"].as<bool>(true))
+        plan = SceneEngine::plan(link_table_,
+            insteon_controller_->getAddress(), targets);
+    else
+        for (std::size_t i = 0; i < targets.size(); i++)
+            plan.direct.push_back(i);
+
+    std::vector<InsteonCommandStatus> statuses(commands.size(),
+            InsteonCommandStatus::Timeout);
+    for (const auto& group : plan.groups) {
+        {
+            std::lock_guard<std::mutex>lock(scene_lock_);
+            scene_active_ = true;
+            scene_command_ = static_cast<uint8_t> (group.command);
+            scene_acked_.clear();
+        }
+        bool complete = insteon_controller_->tryGroupCommand(
+                static_cast<InsteonControllerGroupCommands> (group.command),
+                group.group, group.command_two);
+        std::set<uint32_t> acked;
+        {
+            std::lock_guard<std::mutex>lock(scene_lock_);
+            scene_active_ = false;
+            acked.swap(scene_acked_);
+        }
+        uint8_t level = 0x00;
+        if (group.command == InsteonDeviceCommand::On)
+            level = group.command_two;
+        else if (group.command == InsteonDeviceCommand::FastOn)
+            level = 0xFF;
+        for (std::size_t i : group.targets) {
+            if (!acked.count(targets[i].device_id)) {
+                plan.direct.push_back(i); // missed the group command
+                continue;
+            }
+            statuses[i] = InsteonCommandStatus::Ack;
+            commands[i].device->linkedStatus(level,
+                    StatusSource::DirectAck);
+        }
+        utils::Logger::Instance().Debug("%s\n\t  - group %d reached %zu of %zu "
+                "responders%s", FUNCTION_NAME_CSTR, group.group, acked.size(),
+                group.targets.size(), complete ? "" : ", cleanup failed");
+    }
+    for (std::size_t i : plan.direct)
+        statuses[i] = commands[i].device->execute(commands[i].command,
+            commands[i].command_two);
+
+    if (request_id.empty())
+        return;
+    for (std::size_t i = 0; i < commands.size(); i++) {
+        Json::Value result;
+        result["device_id"] = commands[i].device->insteon_address();
+        result["command"] = commands[i].name;
+        result["status"] = to_string(statuses[i]);
+        results.append(result);
+    }
+    Json::Value json;
+    json["event"] = "commandResult";
+    json["request_id"] = request_id;
+    json["results"] = results;
+    json["latency_ms"] = Json::Int64(std::chrono::duration_cast<
+            std::chrono::milliseconds>(std::chrono::steady_clock::now()
+            - received).count());
+    onCommandResult(session_id, json);
+}
+
+/**
+ * OnCleanupAck
+ * 
+ * A responder acknowledged the cleanup of a group command.
+ * @param insteon_address
+ * @param command_one
+ */
+void
+InsteonNetwork::onCleanupAck(uint32_t insteon_address, uint8_t command_one) {
+    std::lock_guard<std::mutex>lock(scene_lock_);
+    if (scene_active_ && command_one == scene_command_)
+        scene_acked_.insert(insteon_address & 0xFFFFFF);
+}
+
+/**
+ * SuggestGroup
+ * 
+ * Offers clients to program a PLM group for devices that keep being
+ * commanded together, unless a PLM group holding exactly them exists.
+ * @param devices
+ */
+void
+InsteonNetwork::suggestGroup(const GroupProvisioner::device_set& devices) {
+    uint32_t plm_address = insteon_controller_->getAddress();
+    for (const auto& link : link_table_.controllers(devices.front())) {
+        if ((link.controller & 0xFFFFFF) != plm_address)
+            continue;
+        GroupProvisioner::device_set responders;
+        for (const auto& it : link_table_.responders(plm_address, link.group))
+            responders.push_back(it.responder);
+        std::sort(responders.begin(), responders.end());
+        if (responders == devices)
+            return;
+    }
+    utils::Logger::Instance().Info("%s\n\t  - %zu devices are often "
+            "commanded together", FUNCTION_NAME_CSTR, devices.size());
+    if (!on_group_suggestion)
+        return;
+    Json::Value json;
+    json["event"] = "groupSuggestion";
+    json["devices"] = Json::Value(Json::arrayValue);
+    for (uint32_t device_id : devices)
+        json["devices"].append(device_id);
+    int group = insteon_controller_->freeGroup();
+    if (group >= 0)
+        json["group"] = group;
+    io_service_.post(system::profile("InsteonNetwork::suggestGroup",
+            [this, json]{on_group_suggestion(json);}));
+}
+
+/**
+ * ProvisionGroup
+ * 
+ * Programs a PLM group for the devices, see executeProvision.
+ * @param devices
+ * @param group the PLM group, -1 picks the lowest free group
+ * @param request_id
+ * @param session_id the client session that asked for it
+ */
+void
+InsteonNetwork::provisionGroup(std::vector<uint32_t> devices, int group,
+        std::string request_id, uint32_t session_id) {
+    command_queue_.post(CommandPriority::Interactive,
+            std::bind(&type::executeProvision, this, std::move(devices),
+            group, std::move(request_id), session_id));
+}
+
+/**
+ * ExecuteProvision
+ * 
+ * For every device a controller record goes into the PLM database and a
+ * responder record, full on at a fast ramp, into the device ALDB. The
+ * device ALDB has to be cached to find a free record. Reports a
+ * groupProvisioned event to the session that asked.
+ * 
+ * @param devices
+ * @param group
+ * @param request_id
+ * @param session_id
+ */
+void
+InsteonNetwork::executeProvision(std::vector<uint32_t> devices, int group,
+        std::string request_id, uint32_t session_id) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    uint32_t plm_address = insteon_controller_->getAddress();
+    if (group < 0)
+        group = insteon_controller_->freeGroup();
+
+    Json::Value json;
+    json["event"] = "groupProvisioned";
+    if (!request_id.empty())
+        json["request_id"] = request_id;
+    json["results"] = Json::Value(Json::arrayValue);
+    GroupProvisioner::device_set linked;
+    for (uint32_t device_id : devices) {
+        InsteonCommandStatus status = InsteonCommandStatus::Invalid;
+        std::shared_ptr<InsteonDevice> device = getDevice(device_id);
+        InsteonLinkRecord responder;
+        if (device && group > 0 && group < 255 && plm_address) {
+            responder.flags = 0xA2;
+            responder.group = group;
+            responder.link_address = plm_address;
+            responder.data_one = 0xFF;
+            responder.data_two = 0x1F;
+            responder.data_three = 0x01;
+            status = device->addALDBRecord(responder);
+        }
+        if (status == InsteonCommandStatus::Ack) {
+            InsteonLinkRecord controller;
+            controller.flags = 0xE2;
+            controller.group = group;
+            controller.link_address = device->insteon_address();
+            controller.data_one = device->readDeviceProperty(
+                    DeviceProperty::DeviceCategory);
+            controller.data_two = device->readDeviceProperty(
+                    DeviceProperty::DeviceSubcategory);
+            controller.data_three = device->readDeviceProperty(
+                    DeviceProperty::DeviceFirmwareVersion);
+            if (insteon_controller_->tryAddLinkRecord(controller)) {
+                linked.push_back(device->insteon_address());
+            } else {
+                status = InsteonCommandStatus::Nak;
+                // a responder without its controller record is dead weight
+                if (device->removeALDBRecord(responder)
+                        != InsteonCommandStatus::Ack)
+                    utils::Logger::Instance().Warning("%s\n\t  - device "
+                        "%06X keeps a responder record for PLM group %d",
+                        FUNCTION_NAME_CSTR, device->insteon_address(), group);
+            }
+        }
+        Json::Value result;
+        result["device_id"] = device_id;
+        result["status"] = to_string(status);
+        json["results"].append(result);
+    }
+    json["group"] = group;
+    utils::Logger::Instance().Info("%s\n\t  - PLM group %d linked to %zu of "
+            "%zu devices", FUNCTION_NAME_CSTR, group, linked.size(),
+            devices.size());
+    if (linked.size() > 1)
+        provisioner_.provisioned(linked);
+    onCommandResult(session_id, json);
+}
+
+/**
+ * OnCommandResult
+ * Routes the outcome of a command back to our owner, autohub.
+ * @param session_id the client session the command came from
+ * @param json
+ */
+void
+InsteonNetwork::onCommandResult(uint32_t session_id, Json::Value json) {
+    if (on_command_result)
+        io_service_.post(system::profile("InsteonNetwork::onCommandResult",
+                [ = ]{on_command_result(session_id, json);}));
 }
 
 /**
@@ -264,7 +896,8 @@ InsteonNetwork::internalReceiveCommand(std::string json) {
 void
 InsteonNetwork::onUpdateDevice(Json::Value json) {
     if (on_update)
-        io_service_.post([ = ]{on_update(json);});
+        io_service_.post(system::profile("InsteonNetwork::onUpdateDevice",
+                [ = ]{on_update(json);}));
 }
 
 /**
@@ -278,8 +911,13 @@ InsteonNetwork::onMessage(std::shared_ptr<InsteonMessage> im) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
     uint32_t insteon_address = 0;
 
+    // echoes of IM commands only go back to the session that sent the
+    // command, echoes of our own commands aren't relayed
     if (houselinc_tx) {
-        houselinc_tx(im->raw_message);
+        if (im->message_id_ < 0x60)
+            houselinc_tx(0, im->raw_message);
+        else if (im->origin_)
+            houselinc_tx(im->origin_, im->raw_message);
     }
     /*if (im->properties_.size() > 0) {
         std::ostringstream oss;
@@ -304,15 +942,20 @@ InsteonNetwork::onMessage(std::shared_ptr<InsteonMessage> im) {
 
     // route messages to appropriate device or controller
     if (im->properties_.count("from_address")) { // route to device
-        std::shared_ptr<InsteonDevice>device;
         insteon_address = im->properties_["from_address"];
-        if (deviceExists(insteon_address)) {
-            device = getDevice(insteon_address);
-            io_strand_.post(std::bind(&InsteonDevice::OnMessage, device, im));
+        // a single lookup per message
+        std::shared_ptr<InsteonDevice>device = getDevice(insteon_address);
+        if (device) {
+            io_strand_.post(system::profile("InsteonDevice::OnMessage",
+                    std::bind(&InsteonDevice::OnMessage, device, im)));
+            inferLinkedStatus(insteon_address, im);
+            if (im->message_type_ == InsteonMessageType::Ack &&
+                    im->properties_["message_flags_group"])
+                onCleanupAck(insteon_address, im->properties_["command_one"]);
         } else if (im->message_type_ == InsteonMessageType::SetButtonPressed) {
             insteon_controller_->onMessage(im);
         } else {
-            device = addDevice(insteon_address);
+            addDevice(insteon_address);
         }
     } else { // route to controller/PLM
         insteon_controller_->onMessage(im);
@@ -320,6 +963,107 @@ InsteonNetwork::onMessage(std::shared_ptr<InsteonMessage> im) {
 
 }
 
+/**
+ * PollDevice
+ * 
+ * Queues a request a device makes of itself while handling a message in the
+ * Sync lane, so client commands preempt it and no strand thread waits on
+ * the response. A request already queued for the device is not queued
+ * again, a storm of broadcasts or cleanups polls once.
+ * 
+ * @param insteon_address
+ * @param command
+ * @param command_two
+ */
+void
+InsteonNetwork::pollDevice(uint32_t insteon_address,
+        InsteonDeviceCommand command, uint8_t command_two) {
+    uint64_t key = static_cast<uint64_t> (insteon_address) << 16 |
+            static_cast<uint64_t> (command) << 8 | command_two;
+    {
+        std::lock_guard<std::mutex>lock(poll_lock_);
+        if (!poll_pending_.insert(key).second)
+            return;
+    }
+    command_queue_.postAsync(CommandPriority::Sync, [this, key,
+            insteon_address, command, command_two](
+            std::function<void() > done) {
+        {
+            // once started, a newer event polls again
+            std::lock_guard<std::mutex>lock(poll_lock_);
+            poll_pending_.erase(key);
+        }
+        std::shared_ptr<InsteonDevice> device = getDevice(insteon_address);
+        if (!device) {
+            done();
+            return;
+        }
+        device->asyncExecute(command, command_two,
+                [done](InsteonCommandStatus) {
+                    done();
+                });
+    });
+}
+
+/**
+ * OnDeviceALDB
+ * 
+ * Invoked when the ALDB of a device was read, refreshes its links.
+ * @param insteon_address
+ * @param aldb
+ */
+void
+InsteonNetwork::onDeviceALDB(uint32_t insteon_address,
+        const InsteonDevice::LinkDatabase& aldb) {
+    std::vector<InsteonLinkRecord> records;
+    records.reserve(aldb.size());
+    for (const auto& it : aldb)
+        records.push_back(it.second);
+    link_table_.update(insteon_address, records);
+}
+
+/**
+ * InferLinkedStatus
+ * 
+ * Responders of a group follow the broadcast of their controller, ie: a
+ * keypad button, so their new state is known without asking each of them.
+ * On goes to the on level of the responder record, full on if it was never
+ * read.
+ * 
+ * @param controller
+ * @param im
+ */
+void
+InsteonNetwork::inferLinkedStatus(uint32_t controller,
+        const std::shared_ptr<InsteonMessage>& im) {
+    bool on;
+    bool fast = false;
+    switch (im->message_type_) {
+        case InsteonMessageType::FastOnBroadcast:
+            fast = true;
+            // fall through
+        case InsteonMessageType::OnBroadcast:
+            on = true;
+            break;
+        case InsteonMessageType::FastOffBroadcast:
+        case InsteonMessageType::OffBroadcast:
+            on = false;
+            break;
+        default:
+            return;
+    }
+    uint8_t group = im->properties_["group"];
+    for (const auto& link : link_table_.responders(controller, group)) {
+        std::shared_ptr<InsteonDevice> device = getDevice(link.responder);
+        if (!device || link.responder == controller)
+            continue;
+        uint8_t level = 0x00;
+        if (on)
+            level = link.level_known && !fast ? link.on_level : 0xFF;
+        device->linkedStatus(level);
+    }
+}
+
 /**
  * Sets the update handler. The update handler will be called by the network
  * when an update occurs. ie: switch turned on or off.
@@ -333,16 +1077,46 @@ InsteonNetwork::set_update_handler(
 }
 
 void
-InsteonNetwork::set_houselinc_tx(
-        std::function<void(std::vector<uint8_t>) > callback) {
+InsteonNetwork::set_sync_progress_handler(
+        std::function<void(Json::Value) > callback) {
+    on_sync_progress = callback;
+}
+
+void
+InsteonNetwork::set_group_suggestion_handler(
+        std::function<void(Json::Value) > callback) {
+    on_group_suggestion = callback;
+}
+
+void
+InsteonNetwork::set_command_result_handler(
+        std::function<void(uint32_t, Json::Value) > callback) {
+    on_command_result = callback;
+}
+
+void
+InsteonNetwork::set_houselinc_tx(std::function<void(uint32_t,
+        const std::vector<uint8_t>&) > callback) {
     houselinc_tx = callback;
 }
 
 void
-InsteonNetwork::internalRawCommand(std::vector<uint8_t> buffer) {
-    io_strand_.post([ = ](){
-        msg_proc_->trySend(buffer, false);
-    });
+InsteonNetwork::set_tap_handler(tap_handler callback) {
+    msg_proc_->set_tap_handler(callback);
+}
+
+std::shared_ptr<CommandSequence>
+InsteonNetwork::sequence(CommandPriority priority) {
+    return CommandSequence::create(command_queue_, priority);
+}
+
+void
+InsteonNetwork::internalRawCommand(uint32_t session_id,
+        std::vector<uint8_t> buffer) {
+    command_queue_.postAsync(CommandPriority::Raw,
+            [this, session_id, buffer](std::function<void() > done) {
+                msg_proc_->asyncSendRaw(buffer, session_id, done);
+            });
 }
 
 } // namespace insteon
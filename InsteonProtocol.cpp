@@ -185,6 +185,26 @@ InsteonProtocol::getStandardMessageType(const std::vector<uint8_t>& data,
     return message_type;
 }
 
+/* CommandLength
+ * Bytes following the command byte of a host to IM command, 0x60 to 0x79.
+ * The IM echoes the command back with the same length before its ACK/NAK.
+ * A 0x62 carries 14 more bytes when its message flags are extended.
+ * Returns -1 for unknown commands.
+ */
+int32_t
+InsteonProtocol::commandLength(uint8_t command, uint8_t message_flags) {
+    static const int8_t lengths[] = {
+        0, 3, 6, 2, 2, 0, 3, 0, 1, 0, 0, 1, 0, 0, 0, 9, // 0x60 - 0x6F
+        1, 2, 0, 0, 0, 2, 10, 0, 1, 3 // 0x70 - 0x79
+    };
+    if (command < 0x60 || command >= 0x60 + sizeof (lengths))
+        return -1;
+    int32_t length = lengths[command - 0x60];
+    if (command == 0x62 && (message_flags & 0x10))
+        length += 14;
+    return length;
+}
+
 /* ProcessMessage
  * Decodes all Insteon Messages into PropertyKeys(PropertyKey, value) PropertyKey.h
  */
@@ -211,92 +231,19 @@ InsteonProtocol::processMessage(const std::vector<uint8_t>& data,
             return true;
         case 0x60: // get insteon modem info
             return getIMInfo(data, offset, count, insteon_message);
-        case 0x61:
-            if (data.size() < offset + count + 3) return false;
-            count += 3;
-            return true;
         case 0x62:
             return directMessage(data, offset, count, insteon_message);
-        case 0x63:
-            if (data.size() < offset + count + 2) return false;
-            count += 2;
-            return true;
-        case 0x64:
-            if (data.size() < offset + count + 2) return false;
-            count += 2;
-            return true;
-        case 0x65:
-            return (data.size() < offset + count) ? false : true;
-        case 0x66:
-            if (data.size() < offset + count + 3) return false;
-            count += 3;
-            return true;
-        case 0x67:
-            if (data.size() < offset + count) return false;
-            return true;
-        case 0x68:
-            if (data.size() < offset + count + 1) return false;
-            count += 1;
-            return true;
-        case 0x69:
-            if (data.size() < offset + count) return false;
-            return true;
-        case 0x6A:
-            if (data.size() < offset + count) return false;
-            return true;
-        case 0x6B: // TODO set IM configuration 
-            if (data.size() < offset + count + 1) return false;
-            count += 1;
-            return true;
-        case 0x6C:
-            if (data.size() < offset + count) return false;
-            return true;
-        case 0x6D:
-            if (data.size() < offset + count) return false;
-            return true;
-        case 0x6E:
-            if (data.size() < offset + count) return false;
-            return true;
-        case 0x6F:
-            if (data.size() < offset + count + 9) return false;
-            count += 9;
-            return true;
-        case 0x70:
-            if (data.size() < offset + count + 1) return false;
-            count += 1;
-            return true;
-        case 0x71:
-            if (data.size() < offset + count + 2) return false;
-            count += 2;
-            return true;
-        case 0x72:
-            if (data.size() < offset + count) return false;
-            return true;
         case 0x73: // get insteon modem configuration
             return getIMConfiguration(data, offset, count, insteon_message);
-        case 0x74:
-            if (data.size() < offset + count) return false;
+        default: // IM echoes, nothing to decode
+        {
+            int32_t length = commandLength(data[offset]);
+            if (length < 0)
+                break;
+            if (data.size() < offset + count + length) return false;
+            count += length;
             return true;
-        case 0x75: // TODO Read 8 bytes from database
-            if (data.size() < offset + count + 2) return false;
-            count += 2;
-            return true;
-        case 0x76: // TODO Write 8 bytes to Database
-            if (data.size() < offset + count + 10) return false;
-            count += 10;
-            return true;
-        case 0x77:
-            if (data.size() < offset + count) return false;
-            return true;
-        case 0x78:
-            if (data.size() < offset + count + 1) return false;
-            count += 1;
-            return true;
-        case 0x79:
-            if (data.size() < offset + count + 3) return false;
-            count += 3;
-            return true;
-
+        }
     }
     return false;
 }
@@ -29,6 +29,7 @@
 #include "include/utils/utils.hpp"
 #include "include/Logger.h"
 #include "include/system/Timer.hpp"
+#include "include/system/HandlerProfiler.hpp"
 
 #include <iostream>
 #include <iomanip>
@@ -46,9 +47,16 @@ namespace ace
 namespace insteon
 {
 
+namespace {
+// how long the IM is given to deliver a device response after the echo
+const std::chrono::milliseconds kResponseTimeout(4000);
+}
+
 MessageProcessor::MessageProcessor(boost::asio::io_service& io_service,
-        YAML::Node config)
-: io_service_(io_service), io_strand_(io_service), config_(config) , 
+        boost::asio::io_service& plm_io_service, YAML::Node config)
+: io_service_(io_service), plm_io_service_(plm_io_service),
+io_strand_(io_service), raw_origin_(0),
+config_(config) , 
         found_controller_(false) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
 }
@@ -71,12 +79,12 @@ MessageProcessor::connect(PropertyKeys& properties) {
 
     if (plm_type.compare("hub") == 0) {
         io = std::move(std::unique_ptr<io::IOPort>(
-                new io::SocketPort(io_service_)));
+                new io::SocketPort(plm_io_service_)));
         host = config_["hub_ip"].as<std::string>("127.0.0.1");
         port = config_["hub_port"].as<uint16_t>(9761);
     } else {
         io = std::move(std::unique_ptr<io::IOPort>(
-                new io::SerialPort(io_service_)));
+                new io::SerialPort(plm_io_service_)));
         host = config_["serial_port"].as<std::string>("/dev/ttyUSB0");
         port = config_["baud_rate"].as<uint16_t>(19200);
     }
@@ -262,6 +270,8 @@ MessageProcessor::processMessage(const std::vector<uint8_t>& read_buffer,
         auto it = read_buffer.begin() + offset - 1;
         for (; it < read_buffer.begin() + offset + count; it++)
             insteon_message->raw_message.push_back(*it); // copy the buffer
+        if (is_echo)
+            insteon_message->origin_ = raw_origin_;
         if (offset + count < read_buffer.size()) {
             auto response = *(read_buffer.begin() + offset + count);
             if (response == 0x06 || response == 0x15) {
@@ -272,9 +282,13 @@ MessageProcessor::processMessage(const std::vector<uint8_t>& read_buffer,
         } else if (is_echo) {
             return false;
         }
+        if (tap_handler_)
+            tap_handler_(is_echo ? TapDirection::Echo : TapDirection::Rx,
+                insteon_message->raw_message, insteon_message);
         updateWaitItems(insteon_message);
         if (msg_handler_ && found_controller_)
-            io_strand_.post(std::bind(msg_handler_, insteon_message));
+            io_strand_.post(system::profile("InsteonNetwork::onMessage",
+                    std::bind(msg_handler_, insteon_message)));
         return true;
     }
     return false;
@@ -350,6 +364,8 @@ MessageProcessor::send(std::vector<uint8_t> send_buffer,
         }
         time_of_last_command_ = std::chrono::system_clock::now();
         oss.str(std::string());
+        if (tap_handler_)
+            tap_handler_(TapDirection::Tx, send_buffer, nullptr);
         io_port_->send_buffer(send_buffer);
         status = processEcho(echo_length + 2); // +2 because the STX is not included
         if (status == PlmEcho::ACK) {
@@ -395,9 +411,6 @@ PlmEcho
 MessageProcessor::trySend(const std::vector<uint8_t>& send_buffer,
         bool retry_on_nak, uint32_t echo_length) {
     utils::Logger::Instance().Trace(FUNCTION_NAME);
-    PlmEcho status = PlmEcho::NONE;
-    io_port_->set_recv_handler(nullptr); // prevent io from calling a handler
-
     auto duration = config_["command_delay"].as<int>(500);
     auto start = std::chrono::system_clock::now();
     auto difference = std::chrono::duration_cast<std::chrono::milliseconds>
@@ -411,7 +424,26 @@ MessageProcessor::trySend(const std::vector<uint8_t>& send_buffer,
         difference = std::chrono::duration_cast<std::chrono::milliseconds>
                 (start - time_of_last_command_).count();
     }
+    return trySendNow(send_buffer, retry_on_nak, echo_length);
+}
 
+/**
+ * TrySendNow
+ * 
+ * Sends without waiting for command_delay. Only meant for IM commands that
+ * never reach the powerline, ie: walking the PLM database, where every
+ * response would otherwise delay the next request.
+ * 
+ * @param send_buffer
+ * @param retry_on_nak
+ * @param echo_length
+ * @return 
+ */
+PlmEcho
+MessageProcessor::trySendNow(const std::vector<uint8_t>& send_buffer,
+        bool retry_on_nak, uint32_t echo_length) {
+    PlmEcho status = PlmEcho::NONE;
+    io_port_->set_recv_handler(nullptr); // prevent io from calling a handler
     status = send(send_buffer, retry_on_nak, echo_length);
     io_port_->set_recv_handler(std::bind(
             &type::onReceive, this));
@@ -425,6 +457,9 @@ MessageProcessor::trySend(const std::vector<uint8_t>& send_buffer,
  * Tries to send a RAW INSTEON message and waits for a response.
  * Typical response message would be of type 0x50 or 0x51.
  * 
+ * The response is kept by a future, one that arrives before the caller
+ * starts waiting is not lost.
+ * 
  * @param send_buffer RAW INSTEON data
  * @param retry_on_nak True if we should try sending more than once.
  * @param receive_message_id The type of INSTEON message we are waiting for (ie: 0x50)
@@ -435,62 +470,219 @@ PlmEcho
 MessageProcessor::trySendReceive(const std::vector<uint8_t>& send_buffer,
         int8_t triesLeft, uint8_t receive_message_id, PropertyKeys&
         properties) {
-    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    return trySendReceive(send_buffer, triesLeft, receive_message_id,
+            properties, kResponseTimeout);
+}
 
-    std::shared_ptr<WaitItem>item(new WaitItem(receive_message_id));
+/**
+ * TrySendReceive
+ * 
+ * As above, for responses that take longer than a device reply, such as
+ * the 0x58 the PLM sends once it has cleaned up every group responder.
+ * @param timeout how long to wait for the response after each echo
+ */
+PlmEcho
+MessageProcessor::trySendReceive(const std::vector<uint8_t>& send_buffer,
+        int8_t triesLeft, uint8_t receive_message_id, PropertyKeys&
+        properties, std::chrono::milliseconds timeout) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    auto promise = std::make_shared<std::promise<msg_ptr>>();
+    std::future<msg_ptr> response = promise->get_future();
+    std::shared_ptr<WaitItem> item = addWaitItem(receive_message_id,
+            responseAddress(send_buffer), [promise](msg_ptr insteon_message) {
+                promise->set_value(insteon_message);
+            });
     properties.clear();
-    {
-        std::lock_guard<std::mutex>lock(mutex_wait_list_);
-        // always push to the back as IM responses should be in order of sent message
-        wait_list_.push_back(item);
-    }
     PlmEcho status = trySend(send_buffer, triesLeft >= 0);
-    if (status == PlmEcho::ACK) { // got the echo
-        if (!item->insteon_message_) { // still need ACK
-            if (item->wait_event_.WaitOne(4000)) { // wait here for ACK
-                utils::Logger::Instance().Info("%s\n\t  - PLM ACK received",
-                        FUNCTION_NAME_CSTR);
-            } else { // timeout signaled, no event
-                utils::Logger::Instance().Info("%s\n\t  - Timeout signaled: "
-                        "No ACK received from the PLM\n\t  - Retrying command", 
-                        FUNCTION_NAME_CSTR);
-                if (--triesLeft >= 0) {
-                    {
-                        std::lock_guard<std::mutex>lock(mutex_wait_list_);
-                        wait_list_.remove(item);
-                    }
-                    return trySendReceive(send_buffer, triesLeft,
-                            receive_message_id, properties);
-                }
-
-            }
-        }
-        if (item->insteon_message_) {
-            properties = item->insteon_message_->properties_;
-        }
+    if (status != PlmEcho::ACK) {
+        removeWaitItem(item);
+        return status;
     }
-    {
-        std::lock_guard<std::mutex>lock(mutex_wait_list_);
-        wait_list_.remove(item);
+    if (response.wait_for(timeout) != std::future_status::ready &&
+            completeWaitItem(item, nullptr)) {
+        utils::Logger::Instance().Info("%s\n\t  - Timeout signaled: "
+                "No ACK received from the PLM\n\t  - Retrying command",
+                FUNCTION_NAME_CSTR);
+        if (--triesLeft >= 0)
+            return trySendReceive(send_buffer, triesLeft, receive_message_id,
+                properties, timeout);
+        return status;
+    }
+    msg_ptr insteon_message = response.get();
+    if (insteon_message) {
+        utils::Logger::Instance().Info("%s\n\t  - PLM ACK received",
+                FUNCTION_NAME_CSTR);
+        properties = insteon_message->properties_;
     }
     return status;
 }
 
+/**
+ * AsyncSendReceive
+ * 
+ * Sends a RAW INSTEON message, the handler is posted to the io_service once
+ * the response arrives or the last try times out. No thread waits for the
+ * response, the timeout is a steady_timer.
+ * 
+ * @param send_buffer RAW INSTEON data
+ * @param tries_left retries after a timeout, negative to not retry a NAK
+ * @param receive_message_id The type of INSTEON message we are waiting for
+ * @param handler receives the echo status and the response properties
+ */
+void
+MessageProcessor::asyncSendReceive(const std::vector<uint8_t>& send_buffer,
+        int8_t tries_left, uint8_t receive_message_id,
+        send_receive_handler handler) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    std::shared_ptr<WaitItem> item = addWaitItem(receive_message_id,
+            responseAddress(send_buffer), [this, send_buffer, tries_left,
+            receive_message_id, handler](msg_ptr insteon_message) {
+                // sending from here could re-enter the data processor
+                io_service_.post([this, send_buffer, tries_left,
+                        receive_message_id, handler, insteon_message]() {
+                    if (insteon_message) {
+                        handler(PlmEcho::ACK, insteon_message->properties_);
+                    } else if (tries_left - 1 >= 0) {
+                        utils::Logger::Instance().Info("%s\n\t  - Timeout "
+                                "signaled: No ACK received from the PLM\n\t"
+                                "  - Retrying command", FUNCTION_NAME_CSTR);
+                        asyncSendReceive(send_buffer, tries_left - 1,
+                                receive_message_id, handler);
+                    } else {
+                        handler(PlmEcho::ACK, PropertyKeys());
+                    }
+                });
+            });
+    PlmEcho status = trySend(send_buffer, tries_left >= 0);
+    if (status != PlmEcho::ACK) {
+        if (removeWaitItem(item))
+            handler(status, PropertyKeys());
+        return;
+    }
+    expireWaitItem(item, kResponseTimeout);
+}
+
+/**
+ * AsyncSendRaw
+ * 
+ * Sends a raw command from an external client without retries, the client
+ * retries on its own. The echo is tagged with origin so it is only relayed
+ * back to that client. For a direct message done is held back until the
+ * device answers, or the answer times out, so the command queue doesn't
+ * interleave another command with it.
+ * 
+ * @param send_buffer RAW IM command, without STX
+ * @param origin session of the external client
+ * @param done called once the command is finished, from any thread
+ */
 void
-MessageProcessor::updateWaitItems(const std::shared_ptr<InsteonMessage>& iMsg) {
+MessageProcessor::asyncSendRaw(const std::vector<uint8_t>& send_buffer,
+        uint32_t origin, std::function<void() > done) {
+    utils::Logger::Instance().Trace(FUNCTION_NAME);
+    std::shared_ptr<WaitItem> item;
+    if (send_buffer.size() > 3 && send_buffer[0] == 0x62)
+        item = addWaitItem(0x50, responseAddress(send_buffer),
+            [done](msg_ptr) {
+                done();
+            });
+    // sends are serialized by the command queue
+    raw_origin_ = origin;
+    PlmEcho status = trySend(send_buffer, false);
+    raw_origin_ = 0;
+    if (!item) {
+        done();
+    } else if (status != PlmEcho::ACK) {
+        if (removeWaitItem(item))
+            done();
+    } else {
+        expireWaitItem(item, kResponseTimeout);
+    }
+}
+
+// a direct message is answered by the device it was sent to
+uint32_t
+MessageProcessor::responseAddress(const std::vector<uint8_t>& send_buffer) {
+    if (send_buffer.size() > 3 && send_buffer[0] == 0x62)
+        return send_buffer[1] << 16 | send_buffer[2] << 8 | send_buffer[3];
+    return 0;
+}
+
+std::shared_ptr<WaitItem>
+MessageProcessor::addWaitItem(uint8_t message_id, uint32_t from_address,
+        msg_handler handler) {
+    auto item = std::make_shared<WaitItem>(message_id, from_address, handler);
     std::lock_guard<std::mutex>lock(mutex_wait_list_);
-    auto it = wait_list_.begin();
-    for (; it != wait_list_.end(); it++) {
-        if (iMsg->message_id_ == (*it)->message_id_) {
-            if (!(*it)->insteon_message_) {
-                (*it)->insteon_message_ = iMsg;
-                (*it)->message_received_ = true;
-                (*it)->wait_event_.Set();
-            }
+    // always push to the back as IM responses should be in order of sent message
+    wait_list_.push_back(item);
+    return item;
+}
+
+/**
+ * CompleteWaitItem
+ * 
+ * Removes the item and calls its handler, only the first completion of an
+ * item does anything.
+ * 
+ * @return false if the item was already completed or removed
+ */
+bool
+MessageProcessor::completeWaitItem(const std::shared_ptr<WaitItem>& item,
+        msg_ptr insteon_message) {
+    if (!removeWaitItem(item))
+        return false;
+    if (item->on_complete_)
+        item->on_complete_(insteon_message);
+    return true;
+}
+
+// removes the item without calling its handler
+bool
+MessageProcessor::removeWaitItem(const std::shared_ptr<WaitItem>& item) {
+    std::lock_guard<std::mutex>lock(mutex_wait_list_);
+    if (item->completed_)
+        return false;
+    item->completed_ = true;
+    if (item->timer_)
+        item->timer_->cancel();
+    wait_list_.remove(item);
+    return true;
+}
+
+// completes the item with nullptr unless the response arrives first
+void
+MessageProcessor::expireWaitItem(const std::shared_ptr<WaitItem>& item,
+        std::chrono::milliseconds timeout) {
+    std::lock_guard<std::mutex>lock(mutex_wait_list_);
+    if (item->completed_)
+        return;
+    item->timer_.reset(new boost::asio::steady_timer(io_service_, timeout));
+    std::weak_ptr<WaitItem> weak_item(item);
+    item->timer_->async_wait([this, weak_item](
+            const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted)
+            return;
+        if (auto item = weak_item.lock())
+            completeWaitItem(item, nullptr);
+    });
+}
+
+void
+MessageProcessor::updateWaitItems(const std::shared_ptr<InsteonMessage>& iMsg) {
+    std::vector<std::shared_ptr<WaitItem>> matched;
+    {
+        std::lock_guard<std::mutex>lock(mutex_wait_list_);
+        for (const auto& item : wait_list_) {
+            if (iMsg->message_id_ == item->message_id_ &&
+                    (!item->from_address_ || (iMsg->properties_.count(
+                    "from_address") && iMsg->properties_.at("from_address")
+                    == item->from_address_)))
+                matched.push_back(item);
         }
+        utils::Logger::Instance().Trace("%s\n\t  - remaining items %zu",
+                FUNCTION_NAME_CSTR, wait_list_.size() - matched.size());
     }
-    utils::Logger::Instance().Trace("%s\n\t  - remaining items %zu",
-            FUNCTION_NAME_CSTR, wait_list_.size());
+    for (const auto& item : matched)
+        completeWaitItem(item, iMsg);
 }
 
 void
@@ -498,6 +690,11 @@ MessageProcessor::set_message_handler(msg_handler handler) {
     msg_handler_ = handler;
 }
 
+void
+MessageProcessor::set_tap_handler(tap_handler handler) {
+    tap_handler_ = handler;
+}
+
 }
 /* namespace insteon*/
 } // namespace ace
\ No newline at end of file
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "include/insteon/SceneEngine.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace ace {
+namespace insteon {
+
+namespace {
+
+// true if the group command of target leaves the responder of link in the
+// state the responder's own target asks for
+bool
+covers(const SceneTarget& target, const SceneTarget& responder,
+        const InsteonLink& link) {
+    if (responder.command != target.command)
+        return false;
+    if (target.command != InsteonDeviceCommand::On)
+        return true;
+    return link.level_known && link.on_level == responder.command_two;
+}
+
+} // namespace
+
+bool
+SceneEngine::groupable(InsteonDeviceCommand command) {
+    switch (command) {
+        case InsteonDeviceCommand::On:
+        case InsteonDeviceCommand::FastOn:
+        case InsteonDeviceCommand::Off:
+        case InsteonDeviceCommand::FastOff:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Plan
+ * 
+ * @param links
+ * @param plm_address controller of the groups that can be used
+ * @param targets
+ * @return the group broadcasts to send and the targets they leave over
+ */
+ScenePlan
+SceneEngine::plan(const InsteonLinkTable& links, uint32_t plm_address,
+        const std::vector<SceneTarget>& targets) {
+    ScenePlan plan;
+    std::unordered_map<uint32_t, std::size_t> by_device;
+    for (std::size_t i = 0; i < targets.size(); i++)
+        by_device.emplace(targets[i].device_id & 0xFFFFFF, i);
+
+    // every PLM group a target responds to, with the responders it reaches
+    std::vector<std::pair<SceneGroup, InsteonLinkTable::links>> candidates;
+    std::vector<bool> seen(256, false);
+    for (const auto& target : targets) {
+        if (!groupable(target.command))
+            continue;
+        for (const auto& link : links.controllers(target.device_id)) {
+            if (link.controller != (plm_address & 0xFFFFFF) ||
+                    seen[link.group])
+                continue;
+            seen[link.group] = true;
+            InsteonLinkTable::links responders =
+                    links.responders(plm_address, link.group);
+            if (responders.size() < 2)
+                continue; // one broadcast and a cleanup gains nothing
+            SceneGroup group;
+            group.group = link.group;
+            candidates.emplace_back(group, std::move(responders));
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+            [](const std::pair<SceneGroup, InsteonLinkTable::links>& lhs,
+            const std::pair<SceneGroup, InsteonLinkTable::links>& rhs) {
+                return lhs.second.size() > rhs.second.size();
+            });
+
+    std::vector<bool> covered(targets.size(), false);
+    for (auto& candidate : candidates) {
+        SceneGroup& group = candidate.first;
+        const InsteonLinkTable::links& responders = candidate.second;
+        // every responder has to want what the first one wants
+        auto first = by_device.find(responders.front().responder);
+        if (first == by_device.end())
+            continue;
+        const SceneTarget& leader = targets[first->second];
+        group.command = leader.command;
+        group.command_two = leader.command_two;
+
+        bool usable = groupable(group.command);
+        for (const auto& link : responders) {
+            if (!usable)
+                break;
+            auto it = by_device.find(link.responder);
+            usable = it != by_device.end() && !covered[it->second] &&
+                    covers(leader, targets[it->second], link);
+            // a device can hold more than one record for the group, each
+            // has to be covered but the device is one target
+            if (usable && std::find(group.targets.begin(),
+                    group.targets.end(), it->second) == group.targets.end())
+                group.targets.push_back(it->second);
+        }
+        if (!usable)
+            continue;
+        for (std::size_t i : group.targets)
+            covered[i] = true;
+        plan.groups.push_back(std::move(group));
+    }
+    for (std::size_t i = 0; i < targets.size(); i++) {
+        if (!covered[i])
+            plan.direct.push_back(i);
+    }
+    return plan;
+}
+
+} // namespace insteon
+} // namespace ace
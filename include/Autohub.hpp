@@ -29,9 +29,11 @@
 #define AUTOHUB_HPP
 
 #include <memory>
+#include <map>
 #include <cstdint>
 
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
@@ -39,6 +41,8 @@
 
 #include <yaml-cpp/yaml.h>
 
+#include "system/ThreadPool.hpp"
+
 typedef websocketpp::server<websocketpp::config::asio> wspp_server;
 using websocketpp::connection_hdl;
 
@@ -55,6 +59,7 @@ using websocketpp::lib::condition_variable;
 #endif
 
 class server;
+class tap_server;
 
 namespace Json {
     class Value;
@@ -63,19 +68,35 @@ namespace ace {
     class DynamicLibrary;
     namespace insteon {
         class InsteonNetwork;
+        struct InsteonCommand;
+        struct InsteonCommandBatch;
+        class InsteonMessage;
+        enum class TapDirection;
     }
 
     struct connection_data {
         uint32_t session_id;
         std::string name;
         bool authenticated;
+        uint64_t messages_sent;
+        uint64_t messages_coalesced;
+        uint64_t messages_dropped;
+        // latest undelivered update per device while the client is backed up
+        std::map<uint32_t, std::string> pending_updates;
+    };
+
+    // what to do with a client whose outbound queue exceeds the limit
+    enum class SlowClientPolicy {
+        Coalesce, // keep only the latest update per device
+        Disconnect // close the connection
     };
 
     class Autohub {
         typedef Autohub type;
     public:
         Autohub() = delete;
-        Autohub(boost::asio::io_service& io_service, YAML::Node root);
+        Autohub(system::ThreadPool& dispatch_pool,
+                system::ThreadPool& plm_pool, YAML::Node root);
         ~Autohub();
         void burp(std::string burp); // plugin test
         bool start();
@@ -84,15 +105,35 @@ namespace ace {
         void wsppOnOpen(connection_hdl hdl);
         void wsppOnClose(connection_hdl hdl);
         void wsppOnMessage(connection_hdl hdl, wspp_server::message_ptr msg);
+        void wsppOnHttp(connection_hdl hdl);
         connection_data& get_data_from_hdl(connection_hdl hdl);
 
-        void internalReceiveCommand(const std::string json);
+        void internalReceiveCommand(std::string json,
+                insteon::InsteonCommand command);
+        void internalReceiveBatch(std::string json,
+                insteon::InsteonCommandBatch batch);
+        bool parseCommand(const Json::Value& root,
+                insteon::InsteonCommand& command, std::string& error);
+        bool parseBatch(const Json::Value& root,
+                insteon::InsteonCommandBatch& batch, std::string& error);
         void onUpdateDevice(Json::Value json);
+        void onCommandResult(uint32_t session_id, Json::Value json);
+        void onSyncProgress(Json::Value json);
+        void onGroupSuggestion(Json::Value json);
+        void wsppSendUpdate(connection_hdl hdl, connection_data& data,
+                uint32_t device_id, const std::string& payload);
+        void wsppScheduleFlush();
+        void wsppFlushPending();
+        Json::Value wsppStatistics();
+        Json::Value houselincStatistics();
+        Json::Value handlerStatistics(std::size_t count, bool reset);
 
         std::shared_ptr<DynamicLibrary> LoadLibrary(const std::string& path,
                 std::string errorString);
         void TestPlugin();
     private:
+        system::ThreadPool& dispatch_pool_;
+        system::ThreadPool& plm_pool_;
         boost::asio::io_service& io_service_;
         boost::asio::strand strand_hub_;
         std::unique_ptr<insteon::InsteonNetwork> insteon_network_;
@@ -100,17 +141,43 @@ namespace ace {
         std::string yaml_config_file_;
         YAML::Node root_node_;
 
+        // websocket I/O and plugin callbacks run on their own pool, a slow
+        // client or plugin never holds a dispatch thread
+        system::ThreadPool wspp_pool_;
+        boost::asio::io_service& wspp_io_service_;
+
         wspp_server wspp_server_;
         typedef std::map<connection_hdl, connection_data,
         std::owner_less<connection_hdl>> con_list;
         con_list wspp_connections_;
         std::mutex wspp_connections_mutex_;
-        std::thread wspp_server_thread_;
-        uint32_t wspp_next_id_;
+        uint32_t wspp_next_id_; // from 1, session 0 is no session
+
+        // outbound queue limits for slow websocket clients
+        std::size_t wspp_max_buffered_;
+        std::size_t wspp_max_pending_;
+        SlowClientPolicy wspp_slow_client_policy_;
+        boost::asio::steady_timer wspp_flush_timer_;
+        bool wspp_flush_scheduled_;
+        uint64_t wspp_total_coalesced_;
+        uint64_t wspp_total_dropped_;
 
         std::unique_ptr<server> houselinc_server_;
-        void houselincRx(std::vector<uint8_t> buffer);
-        void houselincTx(std::vector<uint8_t> buffer);
+        int houselinc_port_;
+        std::size_t houselinc_max_clients_; // 0 for no limit
+        std::chrono::seconds houselinc_idle_timeout_; // 0 for no limit
+
+        // read-only frame stream, formatted on the websocket threads
+        std::unique_ptr<tap_server> tap_server_;
+        int tap_port_; // 0 disables the tap
+        std::size_t tap_max_clients_; // 0 for no limit
+        void onTap(insteon::TapDirection direction,
+                const std::vector<uint8_t>& raw,
+                const std::shared_ptr<insteon::InsteonMessage>& decoded);
+        void houselincRx(uint32_t session_id,
+                std::vector<std::vector<uint8_t>> frames);
+        void houselincTx(uint32_t session_id,
+                const std::vector<uint8_t>& buffer);
         
         std::map<std::string, std::shared_ptr<DynamicLibrary>> dynamicLibraryMap_;
     };
@@ -19,123 +19,382 @@
 #define HOUSELINCSERVER_HPP
 
 #include "Logger.h"
+#include "insteon/InsteonProtocol.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <utility>
 #include <functional>
 #include <vector>
 #include <cstdint>
 
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 using boost::asio::ip::tcp;
 
+// a host to IM command without its STX
+typedef std::vector<uint8_t> houselinc_frame;
+// an IM message relayed to every session, shared rather than copied
+typedef std::shared_ptr<const std::vector<uint8_t>> houselinc_buffer;
+// receives every complete command of one read, from one session
+typedef std::function<void(uint32_t session_id,
+        std::vector<houselinc_frame> frames) > houselinc_handler;
+
+// a snapshot of one session's counters
+struct houselinc_session_stats {
+    uint32_t id;
+    std::string remote;
+    uint64_t frames_in;
+    uint64_t frames_out;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t idle_ms; // since the last read or completed write
+};
+
 class session
 : public std::enable_shared_from_this<session> {
 public:
 
-    session(tcp::socket socket, std::function<void(
-            std::vector<uint8_t>) > on_receive,
+    session(boost::asio::io_service& io_service, tcp::socket socket,
+            uint32_t id, std::chrono::seconds idle_timeout,
+            houselinc_handler on_receive,
             std::function<void(std::shared_ptr<session>) > on_disconnect)
-    : socket_(std::move(socket)), on_receive_(on_receive),
+    : socket_(std::move(socket)), strand_(io_service), idle_timer_(io_service),
+    idle_timeout_(idle_timeout), id_(id), writing_(false), closed_(false),
+    frames_in_(0), frames_out_(0), bytes_in_(0), bytes_out_(0),
+    last_activity_(now()), on_receive_(on_receive),
     on_disconnect_(on_disconnect) {
+        boost::system::error_code ec;
+        auto endpoint = socket_.remote_endpoint(ec);
+        if (!ec)
+            remote_ = endpoint.address().to_string() + ":" +
+                std::to_string(endpoint.port());
+    }
+
+    uint32_t id() const {
+        return id_;
+    }
+
+    const std::string& remote() const {
+        return remote_;
     }
 
     void start() {
         do_read();
+        if (idle_timeout_.count() > 0)
+            strand_.post(std::bind(&session::start_idle_timer,
+                shared_from_this(), idle_timeout_));
     }
 
-    void do_write(std::vector<uint8_t>buffer) {
+    // safe to call from any thread
+    houselinc_session_stats stats() const {
+        return houselinc_session_stats{id_, remote_, frames_in_, frames_out_,
+            bytes_in_, bytes_out_, static_cast<uint64_t>(
+            std::max<int64_t>(0, now() - last_activity_))};
+    }
+
+    /**
+     * deliver
+     * 
+     * Queues a buffer for this session, safe to call from any thread. The
+     * buffer is held until its write completes.
+     */
+    void deliver(houselinc_buffer buffer) {
         auto self(shared_from_this());
-        boost::asio::async_write(socket_, boost::asio::buffer(buffer, buffer.size()),
-                [this, self](boost::system::error_code ec, std::size_t /*length*/) {
-                    if (!ec) {
-                    } else {
-                        on_disconnect_(shared_from_this());
-                    }
-                });
+        strand_.post([this, self, buffer]() {
+            if (closed_)
+                return;
+            if (write_queue_.size() >= max_queued) {
+                ace::utils::Logger::Instance().Warning("%s\n\t  - session %d "
+                        "is not reading, dropping a message",
+                        FUNCTION_NAME_CSTR, id_);
+                return;
+            }
+            write_queue_.push_back(buffer);
+            if (!writing_)
+                do_write();
+        });
     }
 
 private:
 
+    // one async_write in flight, runs on strand_
+    void do_write() {
+        auto self(shared_from_this());
+        writing_ = true;
+        const houselinc_buffer& buffer = write_queue_.front();
+        boost::asio::async_write(socket_, boost::asio::buffer(*buffer),
+                strand_.wrap([this, self](boost::system::error_code ec,
+                std::size_t length) {
+                    write_queue_.pop_front();
+                    writing_ = false;
+                    if (ec) {
+                        close();
+                        return;
+                    }
+                    frames_out_++;
+                    bytes_out_ += length;
+                    last_activity_ = now();
+                    if (!write_queue_.empty())
+                        do_write();
+                }));
+    }
+
+    // runs on strand_, the server forgets the session once
+    void close() {
+        if (closed_)
+            return;
+        closed_ = true;
+        write_queue_.clear();
+        idle_timer_.cancel();
+        boost::system::error_code ec;
+        socket_.close(ec);
+        on_disconnect_(shared_from_this());
+    }
+
+    /**
+     * start_idle_timer
+     * 
+     * Runs on strand_. Reads and completed writes both count as activity,
+     * so a client that only listens stays connected while it keeps
+     * draining its socket. A session idle for idle_timeout_ is closed.
+     */
+    void start_idle_timer(std::chrono::milliseconds wait) {
+        auto self(shared_from_this());
+        idle_timer_.expires_from_now(wait);
+        idle_timer_.async_wait(strand_.wrap([this, self](
+                const boost::system::error_code& ec) {
+            if (ec || closed_)
+                return;
+            std::chrono::milliseconds idle(now() - last_activity_);
+            if (idle >= idle_timeout_) {
+                ace::utils::Logger::Instance().Info("%s\n\t  - session %d "
+                        "(%s) idle for %lld ms, closing", FUNCTION_NAME_CSTR,
+                        id_, remote_.c_str(),
+                        static_cast<long long>(idle.count()));
+                close();
+                return;
+            }
+            start_idle_timer(idle_timeout_ - idle);
+        }));
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     void do_read() {
         auto self(shared_from_this());
         socket_.async_read_some(boost::asio::buffer(data_, max_length),
-                [this, self](boost::system::error_code ec, std::size_t length) {
+                strand_.wrap([this, self](boost::system::error_code ec,
+                std::size_t length) {
                     if (!ec) {
-                        std::vector<uint8_t> data;
-                        for (std::size_t i = 1; i < length; i++) {
-                            data.push_back(data_[i]);
-                        }
-                        on_receive_(data);
+                        bytes_in_ += length;
+                        last_activity_ = now();
+                        receive_buffer_.insert(receive_buffer_.end(), data_,
+                                data_ + length);
+                        std::vector<houselinc_frame> frames;
+                        extract_frames(frames);
+                        frames_in_ += frames.size();
+                        if (!frames.empty())
+                            on_receive_(id_, std::move(frames));
                         do_read();
-                        //do_write(length);
                     } else {
-                        on_disconnect_(shared_from_this());
+                        close();
                     }
-                });
+                }));
+    }
+
+    /**
+     * extract_frames
+     * 
+     * TCP may split or coalesce commands, the receive buffer holds data
+     * until a command is complete. Commands are delimited by their STX and
+     * the IM command length, bytes that don't start a known command are
+     * skipped.
+     */
+    void extract_frames(std::vector<houselinc_frame>& frames) {
+        std::size_t offset = 0;
+        const std::size_t size = receive_buffer_.size();
+        while (offset < size) {
+            if (receive_buffer_[offset] != 0x02) {
+                offset++;
+                continue;
+            }
+            if (offset + 2 > size)
+                break;
+            uint8_t command = receive_buffer_[offset + 1];
+            if (command == 0x62 && offset + 6 > size)
+                break; // length depends on the message flags
+            int32_t length = ace::insteon::InsteonProtocol::commandLength(
+                    command, command == 0x62 ? receive_buffer_[offset + 5] : 0);
+            if (length < 0) {
+                ace::utils::Logger::Instance().Warning("%s\n\t  - session %d "
+                        "unknown command 0x%02x", FUNCTION_NAME_CSTR, id_,
+                        command);
+                offset++;
+                continue;
+            }
+            if (offset + 2 + length > size)
+                break;
+            frames.emplace_back(receive_buffer_.begin() + offset + 1,
+                    receive_buffer_.begin() + offset + 2 + length);
+            offset += 2 + length;
+        }
+        receive_buffer_.erase(receive_buffer_.begin(),
+                receive_buffer_.begin() + offset);
     }
 
     tcp::socket socket_;
+    boost::asio::io_service::strand strand_; // serializes reads, writes
+    boost::asio::steady_timer idle_timer_;
+    std::chrono::seconds idle_timeout_; // 0 never closes an idle session
+    uint32_t id_;
+    std::string remote_;
+    std::deque<houselinc_buffer> write_queue_;
+    bool writing_;
+    bool closed_;
+
+    // written on strand_, read by stats() from any thread
+    std::atomic<uint64_t> frames_in_;
+    std::atomic<uint64_t> frames_out_;
+    std::atomic<uint64_t> bytes_in_;
+    std::atomic<uint64_t> bytes_out_;
+    std::atomic<int64_t> last_activity_; // steady clock ms
+    std::vector<uint8_t> receive_buffer_; // a partial command at most
 
     enum {
-        max_length = 1024
+        max_length = 1024,
+        max_queued = 1024
     };
     uint8_t data_[max_length];
-    std::function<void(std::vector<uint8_t> buffer) > on_receive_;
+    houselinc_handler on_receive_;
     std::function<void(std::shared_ptr<session>) > on_disconnect_;
 };
 
 class server {
 public:
 
+    /**
+     * server
+     * 
+     * @param port
+     * @param max_clients sessions accepted at once, 0 for no limit
+     * @param idle_timeout seconds a session may be idle, 0 for no limit
+     * @param on_receive
+     */
     server(boost::asio::io_service& io_service, short port,
-            std::function<void(std::vector<uint8_t>) > on_receive)
-    : acceptor_(io_service, tcp::endpoint(tcp::v4(), port)),
-    socket_(io_service), on_receive_(on_receive), client_count_(0) {
+            std::size_t max_clients, std::chrono::seconds idle_timeout,
+            houselinc_handler on_receive)
+    : io_service_(io_service),
+    acceptor_(io_service, tcp::endpoint(tcp::v4(), port)),
+    socket_(io_service), on_receive_(on_receive), max_clients_(max_clients),
+    idle_timeout_(idle_timeout), next_session_id_(1), accepted_(0),
+    rejected_(0) {
         do_accept();
     }
 
-    void SendData(std::vector<uint8_t> buffer) {
+    // every session writes from the same buffer, session_id 0 sends to all
+    void SendData(houselinc_buffer buffer, uint32_t session_id = 0) {
         ace::utils::Logger::Instance().Trace(FUNCTION_NAME);
-        for (auto client : sessions_) {
-            client->do_write(buffer);
+        std::lock_guard<std::mutex>lock(sessions_mutex_);
+        if (session_id) {
+            auto it = sessions_.find(session_id);
+            if (it != sessions_.end())
+                it->second->deliver(buffer);
+            return;
         }
+        for (const auto& it : sessions_)
+            it.second->deliver(buffer);
+    }
+
+    std::vector<houselinc_session_stats> Stats() const {
+        std::vector<houselinc_session_stats> stats;
+        std::lock_guard<std::mutex>lock(sessions_mutex_);
+        stats.reserve(sessions_.size());
+        for (const auto& it : sessions_)
+            stats.push_back(it.second->stats());
+        return stats;
+    }
+
+    std::size_t max_clients() const {
+        return max_clients_;
+    }
+
+    uint64_t accepted() const {
+        return accepted_;
+    }
+
+    uint64_t rejected() const {
+        return rejected_;
     }
 
 private:
 
+    // only one accept is outstanding, the handlers don't overlap
     void do_accept() {
         acceptor_.async_accept(socket_,
                 [this](boost::system::error_code ec) {
                     if (!ec) {
-                        if (client_count_ < 5) {
+                        std::unique_lock<std::mutex>lock(sessions_mutex_);
+                        if (max_clients_ && sessions_.size() >= max_clients_) {
+                            lock.unlock();
+                            rejected_++;
+                            boost::system::error_code ignored;
+                            auto endpoint = socket_.remote_endpoint(ignored);
+                            ace::utils::Logger::Instance().Warning("%s\n\t  - "
+                                    "%zu clients connected, rejecting %s",
+                                    FUNCTION_NAME_CSTR, max_clients_,
+                                    endpoint.address().to_string().c_str());
+                            socket_.close(ignored);
+                        } else {
                             auto client = std::make_shared<session>
-                                    (std::move(socket_), on_receive_,
+                                    (io_service_, std::move(socket_),
+                                    next_session_id_++, idle_timeout_,
+                                    on_receive_,
                                     std::bind(&server::on_disconnect, this,
                                     std::placeholders::_1));
-                            sessions_.push_back(client);
+                            sessions_[client->id()] = client;
+                            lock.unlock();
+                            accepted_++;
+                            ace::utils::Logger::Instance().Info("%s\n\t  - "
+                                    "session %d connected from %s",
+                                    FUNCTION_NAME_CSTR, client->id(),
+                                    client->remote().c_str());
                             client->start();
-                            client_count_++;
                         }
-                        socket_.close();
                     }
                     do_accept();
                 });
     }
 
+    // called from a session strand
     void on_disconnect(std::shared_ptr<session> client) {
-        sessions_.remove(client);
-        client_count_--;
+        std::lock_guard<std::mutex>lock(sessions_mutex_);
+        sessions_.erase(client->id());
     }
 
+    boost::asio::io_service& io_service_;
     tcp::acceptor acceptor_;
     tcp::socket socket_;
-    std::list<std::shared_ptr<session>> sessions_;
-    std::function<void(std::vector<uint8_t> buffer) > on_receive_;
-    uint32_t client_count_;
+    mutable std::mutex sessions_mutex_;
+    std::map<uint32_t, std::shared_ptr<session>> sessions_;
+    houselinc_handler on_receive_;
+    std::size_t max_clients_;
+    std::chrono::seconds idle_timeout_;
+    uint32_t next_session_id_;
+    std::atomic<uint64_t> accepted_;
+    std::atomic<uint64_t> rejected_;
 };
 
 #endif /* HOUSELINCSERVER_HPP */
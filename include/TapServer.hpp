@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* 
+ * File:   TapServer.hpp
+ * 
+ * Read-only view of the serial link for sniffers and other monitoring
+ * tools. Every frame is streamed as one JSON line, nothing a client sends
+ * can reach the IM.
+ */
+
+#ifndef TAPSERVER_HPP
+#define TAPSERVER_HPP
+
+#include "Logger.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+#include <boost/asio.hpp>
+
+// one JSON line, shared by every session it is delivered to
+typedef std::shared_ptr<const std::string> tap_line;
+// device addresses a session subscribed to, empty for every frame
+typedef std::shared_ptr<const std::set<uint32_t>> tap_filter;
+
+class tap_session
+: public std::enable_shared_from_this<tap_session> {
+public:
+
+    tap_session(boost::asio::io_service& io_service,
+            boost::asio::ip::tcp::socket socket, uint32_t id,
+            std::function<void(std::shared_ptr<tap_session>) > on_disconnect)
+    : socket_(std::move(socket)), strand_(io_service), id_(id),
+    writing_(false), closed_(false), dropped_(0),
+    filter_(std::make_shared<const std::set<uint32_t>>()),
+    on_disconnect_(on_disconnect) {
+    }
+
+    uint32_t id() const {
+        return id_;
+    }
+
+    void start() {
+        do_read();
+    }
+
+    // safe to call from any thread
+    bool wants(uint32_t from_address, uint32_t to_address) const {
+        tap_filter filter = std::atomic_load(&filter_);
+        return filter->empty() || filter->count(from_address) ||
+                filter->count(to_address);
+    }
+
+    /**
+     * deliver
+     * 
+     * Queues a line for this session, safe to call from any thread. A
+     * session that doesn't keep up loses lines rather than holding them.
+     */
+    void deliver(tap_line line) {
+        auto self(shared_from_this());
+        strand_.post([this, self, line]() {
+            if (closed_)
+                return;
+            if (write_queue_.size() >= max_queued) {
+                if (dropped_++ % max_queued == 0)
+                    ace::utils::Logger::Instance().Warning("%s\n\t  - tap "
+                            "session %d is not reading, %llu lines dropped",
+                            FUNCTION_NAME_CSTR, id_,
+                            static_cast<unsigned long long>(dropped_));
+                return;
+            }
+            write_queue_.push_back(line);
+            if (!writing_)
+                do_write();
+        });
+    }
+
+private:
+
+    // one async_write in flight, runs on strand_
+    void do_write() {
+        auto self(shared_from_this());
+        writing_ = true;
+        const tap_line& line = write_queue_.front();
+        boost::asio::async_write(socket_, boost::asio::buffer(*line),
+                strand_.wrap([this, self](boost::system::error_code ec,
+                std::size_t /*length*/) {
+                    write_queue_.pop_front();
+                    writing_ = false;
+                    if (ec) {
+                        close();
+                    } else if (!write_queue_.empty()) {
+                        do_write();
+                    }
+                }));
+    }
+
+    // runs on strand_, the server forgets the session once
+    void close() {
+        if (closed_)
+            return;
+        closed_ = true;
+        write_queue_.clear();
+        boost::system::error_code ec;
+        socket_.close(ec);
+        on_disconnect_(shared_from_this());
+    }
+
+    void do_read() {
+        auto self(shared_from_this());
+        socket_.async_read_some(boost::asio::buffer(data_, max_length),
+                strand_.wrap([this, self](boost::system::error_code ec,
+                std::size_t length) {
+                    if (ec) {
+                        close();
+                        return;
+                    }
+                    line_.append(reinterpret_cast<const char*>(data_),
+                            length);
+                    std::size_t end;
+                    while ((end = line_.find('\n')) != std::string::npos) {
+                        parse_line(line_.substr(0, end));
+                        line_.erase(0, end + 1);
+                    }
+                    if (line_.size() > max_length)
+                        line_.clear(); // not a command we know
+                    do_read();
+                }));
+    }
+
+    /**
+     * parse_line
+     * 
+     * The only command is "filter", followed by the device addresses to
+     * stream. "filter" on its own streams every frame again.
+     */
+    void parse_line(const std::string& line) {
+        std::istringstream iss(line);
+        std::string command;
+        iss >> command;
+        if (command.compare("filter") != 0)
+            return;
+        auto filter = std::make_shared<std::set<uint32_t>>();
+        std::string address;
+        while (iss >> address) {
+            try {
+                filter->insert(std::stoul(address, nullptr, 16) & 0xFFFFFF);
+            } catch (const std::exception&) {
+                ace::utils::Logger::Instance().Warning("%s\n\t  - tap session "
+                        "%d invalid address %s", FUNCTION_NAME_CSTR, id_,
+                        address.c_str());
+            }
+        }
+        ace::utils::Logger::Instance().Info("%s\n\t  - tap session %d "
+                "filtering on %zu devices", FUNCTION_NAME_CSTR, id_,
+                filter->size());
+        std::atomic_store(&filter_, tap_filter(std::move(filter)));
+    }
+
+    boost::asio::ip::tcp::socket socket_;
+    boost::asio::io_service::strand strand_; // serializes reads, writes
+    uint32_t id_;
+    std::deque<tap_line> write_queue_;
+    bool writing_;
+    bool closed_;
+    uint64_t dropped_;
+    std::string line_; // a partial command from the client
+    tap_filter filter_; // replaced whole, read with atomic_load
+
+    enum {
+        max_length = 1024,
+        max_queued = 4096
+    };
+    uint8_t data_[max_length];
+    std::function<void(std::shared_ptr<tap_session>) > on_disconnect_;
+};
+
+class tap_server {
+public:
+
+    /**
+     * tap_server
+     * 
+     * @param port
+     * @param max_clients sessions accepted at once, 0 for no limit
+     */
+    tap_server(boost::asio::io_service& io_service, short port,
+            std::size_t max_clients)
+    : io_service_(io_service),
+    acceptor_(io_service, boost::asio::ip::tcp::endpoint(
+    boost::asio::ip::tcp::v4(), port)), socket_(io_service),
+    max_clients_(max_clients), next_session_id_(1), session_count_(0) {
+        do_accept();
+    }
+
+    // lets the I/O path skip formatting while nobody is listening
+    bool subscribed() const {
+        return session_count_ > 0;
+    }
+
+    void Publish(tap_line line, uint32_t from_address, uint32_t to_address) {
+        std::lock_guard<std::mutex>lock(sessions_mutex_);
+        for (const auto& it : sessions_) {
+            if (it.second->wants(from_address, to_address))
+                it.second->deliver(line);
+        }
+    }
+
+private:
+
+    // only one accept is outstanding, the handlers don't overlap
+    void do_accept() {
+        acceptor_.async_accept(socket_,
+                [this](boost::system::error_code ec) {
+                    if (!ec) {
+                        std::unique_lock<std::mutex>lock(sessions_mutex_);
+                        if (max_clients_ && sessions_.size() >= max_clients_) {
+                            lock.unlock();
+                            ace::utils::Logger::Instance().Warning("%s\n\t  - "
+                                    "%zu tap clients connected, rejecting",
+                                    FUNCTION_NAME_CSTR, max_clients_);
+                            boost::system::error_code ignored;
+                            socket_.close(ignored);
+                        } else {
+                            auto client = std::make_shared<tap_session>
+                                    (io_service_, std::move(socket_),
+                                    next_session_id_++,
+                                    std::bind(&tap_server::on_disconnect,
+                                    this, std::placeholders::_1));
+                            sessions_[client->id()] = client;
+                            session_count_ = sessions_.size();
+                            lock.unlock();
+                            client->start();
+                        }
+                    }
+                    do_accept();
+                });
+    }
+
+    // called from a session strand
+    void on_disconnect(std::shared_ptr<tap_session> client) {
+        std::lock_guard<std::mutex>lock(sessions_mutex_);
+        sessions_.erase(client->id());
+        session_count_ = sessions_.size();
+    }
+
+    boost::asio::io_service& io_service_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    boost::asio::ip::tcp::socket socket_;
+    std::mutex sessions_mutex_;
+    std::map<uint32_t, std::shared_ptr<tap_session>> sessions_;
+    std::size_t max_clients_;
+    uint32_t next_session_id_;
+    std::atomic<std::size_t> session_count_;
+};
+
+#endif /* TAPSERVER_HPP */
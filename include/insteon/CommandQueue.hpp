@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef COMMANDQUEUE_HPP
+#define COMMANDQUEUE_HPP
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+
+#include <boost/asio.hpp>
+
+namespace ace {
+namespace insteon {
+
+// Lanes of the PLM command queue, highest priority first
+enum class CommandPriority : uint8_t {
+    Interactive, // commands issued by clients
+    Raw, // raw IM commands relayed from external tools, ie: HouseLinc
+    Sync, // background work, ie: startup device sync
+    Count
+};
+
+/*
+ * CommandQueue
+ * 
+ * Serializes work bound for the PLM. Jobs run one at a time on the network
+ * strand, the next job is picked from the highest priority lane which has
+ * work, so an interactive command never waits behind more than the job
+ * already in flight.
+ */
+class CommandQueue {
+    typedef CommandQueue type;
+public:
+    typedef std::function<void() > job;
+    // holds the queue until it calls done, exactly once, from any thread
+    typedef std::function<void(std::function<void() > done) > async_job;
+
+    explicit CommandQueue(boost::asio::io_service::strand& io_strand);
+    CommandQueue(const CommandQueue& rhs) = delete;
+    CommandQueue& operator=(const CommandQueue& rhs) = delete;
+
+    void post(CommandPriority priority, job work);
+    void postAsync(CommandPriority priority, async_job work);
+    std::size_t pending(CommandPriority priority);
+    boost::asio::io_service::strand& strand(); // where jobs start
+    bool idle();
+
+private:
+    static constexpr std::size_t kLaneCount =
+            static_cast<std::size_t> (CommandPriority::Count);
+
+    void runNext();
+    void finish();
+
+    boost::asio::io_service::strand& io_strand_;
+    std::mutex lock_;
+    std::array<std::deque<async_job>, kLaneCount> lanes_;
+    bool running_; // a runNext is posted or executing
+};
+
+} // namespace insteon
+} // namespace ace
+#endif /* COMMANDQUEUE_HPP */
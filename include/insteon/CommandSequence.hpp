@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef COMMANDSEQUENCE_HPP
+#define COMMANDSEQUENCE_HPP
+
+#include "CommandQueue.hpp"
+#include "InsteonCommand.hpp"
+#include "InsteonDeviceCommands.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#define AUTOHUB_COROUTINES 1
+#endif
+
+namespace ace {
+namespace insteon {
+
+class InsteonDevice;
+
+/*
+ * CommandSequence
+ * 
+ * Multi-step device work written as a chain of continuations on the network
+ * strand, no thread waits between or during the steps. Each device command
+ * is queued on its own in the lane of the sequence, so a higher priority
+ * command can still go out between two steps. The sequence stops at the
+ * first step that isn't acknowledged unless keepGoing is set, and it can be
+ * cancelled or given a deadline.
+ * 
+ *   network.sequence(CommandPriority::Sync)
+ *       ->then(device, InsteonDeviceCommand::LightStatusRequest, 0x02)
+ *       ->then(device, InsteonDeviceCommand::ExtendedGetSet)
+ *       ->timeout(std::chrono::seconds(30))
+ *       ->start([](InsteonCommandStatus status) { ... });
+ * 
+ * With C++20 coroutines the same steps can be awaited one by one:
+ * 
+ *   InsteonCommandStatus status = co_await sequence->await(device,
+ *       InsteonDeviceCommand::On, 0xFF);
+ */
+class CommandSequence : public std::enable_shared_from_this<CommandSequence> {
+    typedef CommandSequence type;
+public:
+    typedef std::function<void(InsteonCommandStatus status) > handler;
+    // a step reports its outcome by calling next exactly once
+    typedef std::function<void(handler next) > step;
+
+    static std::shared_ptr<CommandSequence> create(CommandQueue& queue,
+            CommandPriority priority);
+    CommandSequence(const CommandSequence& rhs) = delete;
+    CommandSequence& operator=(const CommandSequence& rhs) = delete;
+
+    // building, only before start
+    std::shared_ptr<CommandSequence> then(step work);
+    std::shared_ptr<CommandSequence> then(std::shared_ptr<InsteonDevice> device,
+            InsteonDeviceCommand command, uint8_t command_two = 0x00);
+    std::shared_ptr<CommandSequence> timeout(std::chrono::milliseconds timeout);
+    std::shared_ptr<CommandSequence> keepGoing();
+
+    void start(handler done);
+    void cancel();
+    // the status of every step, valid once done is called
+    const std::vector<InsteonCommandStatus>& statuses() const;
+
+    void execute(std::shared_ptr<InsteonDevice> device,
+            InsteonDeviceCommand command, uint8_t command_two, handler done);
+
+#ifdef AUTOHUB_COROUTINES
+
+    // resumes the coroutine on the network strand
+    class awaiter {
+    public:
+
+        awaiter(std::shared_ptr<CommandSequence> sequence,
+                std::shared_ptr<InsteonDevice> device,
+                InsteonDeviceCommand command, uint8_t command_two)
+        : sequence_(std::move(sequence)), device_(std::move(device)),
+        command_(command), command_two_(command_two),
+        status_(InsteonCommandStatus::Cancelled) {
+        }
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            sequence_->execute(device_, command_, command_two_,
+                    [this, coroutine](InsteonCommandStatus status) {
+                        status_ = status;
+                        coroutine.resume();
+                    });
+        }
+
+        InsteonCommandStatus await_resume() const noexcept {
+            return status_;
+        }
+
+    private:
+        std::shared_ptr<CommandSequence> sequence_;
+        std::shared_ptr<InsteonDevice> device_;
+        InsteonDeviceCommand command_;
+        uint8_t command_two_;
+        InsteonCommandStatus status_;
+    };
+
+    awaiter await(std::shared_ptr<InsteonDevice> device,
+            InsteonDeviceCommand command, uint8_t command_two = 0x00) {
+        return awaiter(shared_from_this(), std::move(device), command,
+                command_two);
+    }
+#endif
+
+private:
+    CommandSequence(CommandQueue& queue, CommandPriority priority);
+
+    void runNext();
+    void stepDone(std::size_t index, InsteonCommandStatus status);
+    void finish(InsteonCommandStatus status);
+
+    CommandQueue& queue_;
+    boost::asio::io_service::strand io_strand_; // the strand of queue_
+    CommandPriority priority_;
+    boost::asio::steady_timer deadline_;
+    std::chrono::milliseconds timeout_; // 0 for no deadline
+    std::vector<step> steps_;
+    std::vector<InsteonCommandStatus> statuses_;
+    std::size_t next_; // the step to run next
+    bool keep_going_;
+    bool cancelled_; // set once finished, later steps aren't sent
+    InsteonCommandStatus result_; // first status other than Ack
+    handler done_;
+};
+
+} // namespace insteon
+} // namespace ace
+#endif /* COMMANDSEQUENCE_HPP */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DEVICESNAPSHOT_HPP
+#define DEVICESNAPSHOT_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace ace {
+namespace insteon {
+
+// Runtime state of a single device as stored in the snapshot file
+struct DeviceSnapshotRecord {
+    uint32_t address;
+    uint8_t light_status;
+    uint8_t link_database_delta; // valid when flags has kHasDelta
+    uint8_t status_source; // a StatusSource value
+    uint8_t flags; // DeviceSnapshot::kHasDelta
+    int64_t last_seen; // unix time the device was last heard from
+    int64_t status_confirmed; // unix time the status was confirmed, 0 never
+};
+
+static_assert(sizeof (DeviceSnapshotRecord) == 24,
+        "snapshot records are written as is, keep them packed");
+
+/*
+ * DeviceSnapshot
+ * 
+ * A compact binary file holding the runtime state of every device, written
+ * periodically and at shutdown. At startup the file is memory mapped and its
+ * records are used to restore known state before the PLM is queried.
+ * 
+ * File layout: a fixed header followed by count fixed size records.
+ */
+class DeviceSnapshot {
+public:
+    static const uint8_t kHasDelta = 0x01;
+
+    static bool write(const std::string& path,
+            const std::vector<DeviceSnapshotRecord>& records);
+    static bool load(const std::string& path,
+            const std::function<void(const DeviceSnapshotRecord&)>& visit);
+};
+
+} // namespace insteon
+} // namespace ace
+#endif /* DEVICESNAPSHOT_HPP */
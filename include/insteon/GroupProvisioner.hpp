@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef GROUPPROVISIONER_HPP
+#define GROUPPROVISIONER_HPP
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace ace {
+namespace insteon {
+
+/*
+ * GroupProvisioner
+ * 
+ * Learns which devices are commanded together, from batches and from
+ * single commands sent in quick succession, so the hub can offer to program
+ * a PLM group for them. A set is suggested once, after it was commanded
+ * threshold times, and never again once it is provisioned.
+ */
+class GroupProvisioner {
+public:
+    typedef std::vector<uint32_t> device_set; // sorted, unique addresses
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    GroupProvisioner();
+    GroupProvisioner(const GroupProvisioner& rhs) = delete;
+    GroupProvisioner& operator=(const GroupProvisioner& rhs) = delete;
+
+    void configure(unsigned threshold, std::chrono::milliseconds window);
+    bool observe(device_set devices, device_set& suggestion);
+    bool observeCommand(uint32_t device_id, time_point when,
+            device_set& suggestion);
+    void provisioned(device_set devices);
+
+private:
+
+    struct usage {
+        unsigned count;
+        bool suggested;
+        uint64_t used; // tick_ of the last observation
+    };
+
+    static constexpr std::size_t kMaxTracked = 256;
+    static constexpr std::size_t kMaxBurst = 64;
+
+    static void normalize(device_set& devices);
+    bool count(const device_set& devices, device_set& suggestion);
+    usage& track(const device_set& devices);
+
+    std::mutex lock_;
+    std::map<device_set, usage> sets_;
+    uint64_t tick_;
+    device_set burst_; // devices commanded one after the other
+    time_point burst_last_;
+    unsigned threshold_; // 0 disables suggestions
+    std::chrono::milliseconds window_;
+};
+
+} // namespace insteon
+} // namespace ace
+#endif /* GROUPPROVISIONER_HPP */
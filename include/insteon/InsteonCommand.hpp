@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef INSTEONCOMMAND_HPP
+#define INSTEONCOMMAND_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace ace {
+namespace insteon {
+
+// The outcome of a command, reported back to the client that sent it
+enum class InsteonCommandStatus : uint8_t {
+    Ack, // the device acknowledged the command
+    Nak, // the PLM or the device refused the command
+    Timeout, // no response from the PLM or the device
+    Disabled, // the device is disabled, nothing was sent
+    Invalid, // unknown device or command, nothing was sent
+    Cancelled // the command sequence was cancelled before it was sent
+};
+
+inline const char*
+to_string(InsteonCommandStatus status) {
+    switch (status) {
+        case InsteonCommandStatus::Ack: return "ack";
+        case InsteonCommandStatus::Nak: return "nak";
+        case InsteonCommandStatus::Timeout: return "timeout";
+        case InsteonCommandStatus::Disabled: return "disabled";
+        case InsteonCommandStatus::Invalid: return "invalid";
+        case InsteonCommandStatus::Cancelled: return "cancelled";
+    }
+    return "unknown";
+}
+
+// A single command addressed to an INSTEON device, as received from a client
+struct InsteonCommand {
+
+    InsteonCommand() : device_id(0), command_two(0x00), session_id(0) {
+    }
+
+    InsteonCommand(uint32_t device_id, std::string command, uint8_t command_two)
+    : device_id(device_id), command(std::move(command)),
+    command_two(command_two), session_id(0) {
+    }
+
+    uint32_t device_id;
+    std::string command;
+    uint8_t command_two;
+    std::string request_id; // optional, a commandResult is sent when present
+    uint32_t session_id; // the client session the command came from
+};
+
+/*
+ * A set of commands handed to the network as a single unit, ie: a scene.
+ * 
+ * When ordered is false the network is free to reorder the commands and
+ * to merge commands that share command/command_two into fewer transmissions.
+ */
+struct InsteonCommandBatch {
+
+    InsteonCommandBatch() : ordered(false), session_id(0) {
+    }
+
+    std::vector<InsteonCommand> commands;
+    bool ordered;
+    std::string request_id;
+    uint32_t session_id;
+};
+
+}
+}
+
+#endif /* INSTEONCOMMAND_HPP */
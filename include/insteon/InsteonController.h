@@ -29,9 +29,14 @@
 
 #include "InsteonLinkMode.h"
 #include "InsteonControllerGroupCommands.h"
+#include "InsteonLinkRecord.hpp"
 #include "PropertyKey.hpp"
 
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
+#include <vector>
 
 #include <boost/asio.hpp>
 
@@ -54,6 +59,7 @@ namespace ace {
         public:
 
             uint32_t getAddress();
+            void setAddress(uint32_t address);
 
             void enterLinkMode(InsteonLinkMode mode, uint8_t group);
 
@@ -64,14 +70,23 @@ namespace ace {
 
             void groupCommand(InsteonControllerGroupCommands command,
                     uint8_t group, uint8_t value);
-            void getDatabaseRecords(uint8_t one, uint8_t two);
+
+            bool tryGroupCommand(InsteonControllerGroupCommands command,
+                    uint8_t group);
+
+            bool tryGroupCommand(InsteonControllerGroupCommands command,
+                    uint8_t group, uint8_t value);
+            void loadDatabase();
+            bool waitForDatabase(std::chrono::milliseconds timeout);
+            std::vector<InsteonLinkRecord> database();
+            int freeGroup();
+            bool tryAddLinkRecord(InsteonLinkRecord record);
             void getIMConfiguration();
 
             bool enableMonitorMode();
 
             void onMessage(std::shared_ptr<InsteonMessage>
                     insteon_message);
-            bool is_loading_database_;
         private:
             void internalSend(const std::vector<uint8_t>& buffer);
 
@@ -84,22 +99,26 @@ namespace ace {
             void processDatabaseRecord(
                     std::shared_ptr<insteon::InsteonMessage> im);
 
-            void setAddress(uint32_t address);
+            void requestDatabaseRecord(uint8_t command);
+
+            void finishDatabase(bool complete);
 
             bool tryEnterLinkMode(InsteonLinkMode mode, uint8_t group);
 
             bool tryCancelLinkMode();
 
-            bool tryGroupCommand(InsteonControllerGroupCommands command,
-                    uint8_t group);
-
-            bool tryGroupCommand(InsteonControllerGroupCommands command,
-                    uint8_t group, uint8_t value);
-
             std::unique_ptr<detail::InsteonController_impl> pImpl_;
 
             InsteonNetwork *insteon_network_;
             PropertyKeys controller_properties_;
+
+            // PLM all-link database, in the order the PLM returns it
+            std::mutex database_lock_;
+            std::condition_variable database_loaded_;
+            bool is_loading_database_;
+            std::vector<InsteonLinkRecord> database_;
+            std::vector<InsteonLinkRecord> database_pending_;
+            std::chrono::steady_clock::time_point database_started_;
         };
     } // namespace network
 } // namespace ace
@@ -33,11 +33,18 @@
 #include <memory>
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <chrono>
 
 #include "InsteonAddress.h"
 #include "InsteonMessageType.hpp"
 #include "InsteonDeviceCommands.hpp"
+#include "InsteonCommand.hpp"
+#include "EchoStatus.hpp"
 #include "PropertyKey.hpp"
+#include "InsteonDeviceState.hpp"
+#include "DeviceSnapshot.hpp"
+#include "InsteonLinkRecord.hpp"
 
 #include <cstdint>
 
@@ -64,6 +71,16 @@ class InsteonAddress;
 class InsteonDevice {
     typedef InsteonDevice type;
 public:
+    // link records keyed by their memory address in the device
+    typedef std::map<uint16_t, InsteonLinkRecord> LinkDatabase;
+    typedef std::function<void(bool complete) > ALDBHandler;
+    typedef std::function<void(InsteonCommandStatus status) > CommandHandler;
+    typedef std::function<void(uint32_t insteon_address,
+            const LinkDatabase& aldb) > ALDBUpdateHandler;
+    // queues a request the device makes of itself, ie: a status poll
+    typedef std::function<void(uint32_t insteon_address,
+            InsteonDeviceCommand command, uint8_t command_two) > PollHandler;
+
     InsteonDevice() = delete;
     InsteonDevice(uint32_t insteon_address,
                   boost::asio::io_service::strand& io_strand,
@@ -81,23 +98,52 @@ public:
     void set_message_proc(std::shared_ptr<MessageProcessor> messenger);
     void set_update_handler(
                             std::function<void(Json::Value json) > callback);
+    void set_status_ttl(std::chrono::seconds ttl);
+    void set_aldb_timeout(std::chrono::milliseconds timeout);
+    void set_aldb_update_handler(ALDBUpdateHandler callback);
+    void set_poll_handler(PollHandler callback);
     /* member variables, setters and getters */
     uint32_t insteon_address(); // returns insteon address assigned to this device
     std::string device_name(); // returns the name assigned to this device
     bool device_disabled();
+    int64_t last_seen(); // unix time this device was last heard from
+    bool statusUncertain();
+    DeviceSnapshotRecord snapshotRecord();
+    void restore(const DeviceSnapshotRecord& record);
+
+    bool aldbStale(); // true if the cached ALDB doesn't match the delta
+    void readALDB(ALDBHandler done, CommandHandler requested = nullptr);
+    LinkDatabase aldb(); // copy of the cached ALDB
+    InsteonCommandStatus addALDBRecord(InsteonLinkRecord& record);
+    InsteonCommandStatus removeALDBRecord(InsteonLinkRecord record);
+    // state implied by a group command of a controller
+    void linkedStatus(uint8_t level,
+                      StatusSource source = StatusSource::Broadcast);
 
     bool command(InsteonDeviceCommand command, uint8_t command_two);
+    InsteonCommandStatus execute(InsteonDeviceCommand command,
+                                 uint8_t command_two);
+    void asyncExecute(InsteonDeviceCommand command, uint8_t command_two,
+                      CommandHandler done);
+    bool resolveCommand(const std::string& command, uint8_t command_two,
+                        InsteonDeviceCommand& resolved, uint8_t& value);
     void internalReceiveCommand(std::string command, uint8_t command_two);
-    void writeDeviceProperty(const std::string key, const uint32_t value);
-    uint32_t readDeviceProperty(const std::string key,
+    void writeDeviceProperty(const std::string& key, const uint32_t value);
+    uint32_t readDeviceProperty(const std::string& key,
+                               uint32_t default_value = 0);
+    void writeDeviceProperty(DeviceProperty property, const uint32_t value);
+    uint32_t readDeviceProperty(DeviceProperty property,
                                uint32_t default_value = 0);
 
 protected:
-    bool tryCommand(uint8_t command, uint8_t value);
-    bool tryGetExtendedInformation();
-    bool tryReadWriteALDB();
-    bool tryLightStatusRequest();
-    void statusUpdate(uint8_t status);
+    InsteonCommandStatus prepareCommand(InsteonDeviceCommand command,
+                                        uint8_t command_two,
+                                        std::vector<uint8_t>& send_buffer,
+                                        uint8_t& receive_message_id);
+    InsteonCommandStatus finishCommand(InsteonDeviceCommand command,
+                                       InsteonCommandStatus status,
+                                       PropertyKeys& properties);
+    void statusUpdate(uint8_t status, StatusSource source);
     //boost::asio::io_service& io_service_;
     boost::asio::io_service::strand io_strand_;
 
@@ -109,6 +155,10 @@ private:
     std::function<void(Json::Value) > onStatusUpdate;
 
     void ackOfDirectCommand(const std::shared_ptr<InsteonMessage>& im);
+    void poll(InsteonDeviceCommand command, uint8_t command_two);
+    PollHandler on_poll_;
+    static InsteonCommandStatus commandStatus(PlmEcho status,
+                                              PropertyKeys& properties);
     void BuildDirectStandardMessage(std::vector<uint8_t>& send_buffer,
                                     uint8_t cmd1, uint8_t cmd2);
     void BuildDirectExtendedMessage(std::vector<uint8_t>& send_buffer,
@@ -123,20 +173,43 @@ private:
     void device_name(std::string device_name);
     void device_disabled(bool disabled);
     std::string device_name_;
-    bool device_disabled_;
+    std::atomic<bool> device_disabled_; // set on failures from any thread
 
     InsteonAddress insteon_address_;
-    PropertyKeys device_properties_; // properties of this device
-    std::mutex property_lock_; // mutex lock for access to device_properties
+    InsteonDeviceState device_state_; // properties of this device
+    std::mutex config_lock_; // mutex lock for access to config_
 
     void loadProperties(); // loads properties of this devices from config
     YAML::Node config_; // YAML node used to store configuration of this device
 
     uint8_t direct_cmd_; // the last command sent by/to this device
+
+    std::chrono::seconds status_ttl_; // how long a confirmed status is trusted
+    std::atomic<bool> extended_requested_; // ExtendedGetSet sent once only
+    std::atomic<int64_t> last_seen_; // unix time of the last message
+    void touch(); // records that the device was heard from
+
+    // all-link database cache, records stream in after a single read request
+    void onALDBRecord(PropertyKeys& properties);
+    void beginALDB();
+    void armALDBTimer();
+    void finishALDB(bool complete);
+    void loadALDB(); // loads the cached ALDB from config
+    InsteonCommandStatus writeALDBRecord(const InsteonLinkRecord& record,
+            int32_t delta);
+    std::mutex aldb_lock_;
+    // held by add and removeALDBRecord across the write
+    std::mutex aldb_write_lock_;
+    LinkDatabase aldb_; // last complete read
+    LinkDatabase aldb_pending_; // read in progress
+    int32_t aldb_delta_; // link_database_delta of aldb_, -1 if unknown
+    bool aldb_loading_;
+    ALDBHandler aldb_done_;
+    ALDBUpdateHandler on_aldb_update_;
+    boost::asio::steady_timer aldb_timer_;
+    std::chrono::milliseconds aldb_timeout_;
 };
 
-typedef std::map<int, std::shared_ptr<InsteonDevice >> InsteonDeviceMap;
-typedef std::pair<int, std::shared_ptr<InsteonDevice >> InsteonDeviceMapPair;
 } // namespace insteon
 } // namespace ace
 #endif /* INSTEONDEVICEBASE_H */
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef INSTEONDEVICEREGISTRY_HPP
+#define INSTEONDEVICEREGISTRY_HPP
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+namespace ace {
+namespace insteon {
+
+class InsteonDevice;
+
+/*
+ * InsteonDeviceRegistry
+ * 
+ * Maps 24-bit INSTEON addresses to devices.
+ * Devices are kept in a flat vector sorted by address and published as an
+ * immutable snapshot. A lookup holds a brief global lock only to load the
+ * snapshot (std::atomic_load on a shared_ptr is not lock free in
+ * libstdc++), then binary searches contiguous memory without locking.
+ * Insertions are rare (discovery, linking), they copy the table and
+ * publish the new snapshot under a mutex.
+ */
+class InsteonDeviceRegistry {
+public:
+    typedef std::pair<uint32_t, std::shared_ptr<InsteonDevice>> entry;
+    typedef std::vector<entry> table;
+    typedef std::function<std::shared_ptr<InsteonDevice>(uint32_t)> factory;
+
+    InsteonDeviceRegistry();
+    InsteonDeviceRegistry(const InsteonDeviceRegistry& rhs) = delete;
+    InsteonDeviceRegistry& operator=(const InsteonDeviceRegistry& rhs) = delete;
+
+    std::shared_ptr<InsteonDevice> find(uint32_t insteon_address) const;
+    std::shared_ptr<InsteonDevice> insert(uint32_t insteon_address,
+            const factory& create);
+    std::shared_ptr<const table> snapshot() const;
+    std::size_t size() const;
+
+private:
+    static uint32_t key(uint32_t insteon_address) {
+        return insteon_address & 0xFFFFFF;
+    }
+    static std::shared_ptr<InsteonDevice> search(const table& devices,
+            uint32_t key);
+
+    std::shared_ptr<const table> table_; // accessed with atomic_load/store
+    std::mutex insert_lock_; // serializes writers only
+};
+
+} // namespace insteon
+} // namespace ace
+#endif /* INSTEONDEVICEREGISTRY_HPP */
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef INSTEONDEVICESTATE_HPP
+#define INSTEONDEVICESTATE_HPP
+
+#include "PropertyKey.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+namespace ace {
+namespace insteon {
+
+// Well known device properties, stored in a fixed slot per device
+enum class DeviceProperty : uint8_t {
+    LightStatus,
+    ButtonOnLevel,
+    ButtonOnRampRate,
+    LinkDatabaseDelta,
+    DeviceCategory,
+    DeviceSubcategory,
+    DeviceFirmwareVersion,
+    DeviceEngineVersion,
+    X10HouseCode,
+    X10UnitCode,
+    SignalToNoiseThreshold,
+    EnableBlinkOnTraffic,
+    EnableLed,
+    EnableLoadSense,
+    EnableProgrammingLock,
+    EnableResumeDim,
+    MessageFlagsMaxHops,
+    Count
+};
+
+// How the current light status was last confirmed
+enum class StatusSource : uint8_t {
+    Unknown, // loaded from config or never confirmed
+    Broadcast, // the device announced a state change
+    Cleanup, // a group cleanup repeated a broadcast we already saw
+    DirectAck, // the device acknowledged a direct command
+    StatusRequest, // the device answered a LightStatusRequest
+    Snapshot // restored from the snapshot written before a restart
+};
+
+/*
+ * InsteonDeviceState
+ * 
+ * Holds the properties of a single device.
+ * Well known properties live in an array of atomics indexed by DeviceProperty,
+ * reads never take a lock and never contend with PLM driven writes.
+ * Any other key is kept in a side map guarded by a mutex.
+ */
+class InsteonDeviceState {
+public:
+    InsteonDeviceState();
+    InsteonDeviceState(const InsteonDeviceState& rhs) = delete;
+    InsteonDeviceState& operator=(const InsteonDeviceState& rhs) = delete;
+
+    static bool lookup(const std::string& key, DeviceProperty& property);
+    static const char* name(DeviceProperty property);
+
+    // get returns false if the property has never been written
+    bool get(DeviceProperty property, uint32_t& value) const;
+    uint32_t read(DeviceProperty property, uint32_t default_value) const;
+    void write(DeviceProperty property, uint32_t value);
+
+    bool get(const std::string& key, uint32_t& value) const;
+    void write(const std::string& key, uint32_t value);
+
+    // copy of every property which has been set, for serialization
+    PropertyKeys snapshot() const;
+
+    // freshness of the light status
+    void confirmStatus(StatusSource source);
+    void confirmStatus(StatusSource source,
+            std::chrono::steady_clock::time_point when);
+    StatusSource statusSource() const;
+    // time of the last confirmation, epoch of steady_clock if never
+    std::chrono::steady_clock::time_point statusConfirmed() const;
+    bool statusFresh(std::chrono::steady_clock::duration ttl) const;
+
+private:
+    static constexpr std::size_t kPropertyCount =
+            static_cast<std::size_t> (DeviceProperty::Count);
+    static_assert(kPropertyCount <= 32, "presence mask holds 32 properties");
+
+    std::array<std::atomic<uint32_t>, kPropertyCount> values_;
+    std::atomic<uint32_t> present_; // bit set once a property is written
+
+    // steady_clock ticks of the last status confirmation, zero if never
+    std::atomic<int64_t> status_confirmed_;
+    std::atomic<uint8_t> status_source_;
+
+    mutable std::mutex custom_lock_;
+    PropertyKeys custom_; // rarely used keys outside of the fixed schema
+};
+
+} // namespace insteon
+} // namespace ace
+#endif /* INSTEONDEVICESTATE_HPP */
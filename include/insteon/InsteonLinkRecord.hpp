@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef INSTEONLINKRECORD_HPP
+#define INSTEONLINKRECORD_HPP
+
+#include "PropertyKey.hpp"
+
+#include <cstdint>
+
+namespace ace {
+namespace insteon {
+
+/*
+ * InsteonLinkRecord
+ * 
+ * A single all-link database record, as stored in a device or the PLM.
+ * flags bit 7: record in use, bit 6: controller(1) or responder(0),
+ * bit 1: cleared on the high water mark, the first never used record.
+ */
+struct InsteonLinkRecord {
+
+    InsteonLinkRecord() : memory_address(0), flags(0), group(0),
+    link_address(0), data_one(0), data_two(0), data_three(0) {
+    }
+
+    // builds a record from the properties of a decoded link record message
+    explicit InsteonLinkRecord(PropertyKeys& properties)
+    : memory_address(properties["db_address_MSB"] << 8 |
+    properties["db_address_LSB"]),
+    flags(properties["link_type"]), group(properties["link_group"]),
+    link_address(properties["link_address"]),
+    data_one(properties["link_data_one"]),
+    data_two(properties["link_data_two"]),
+    data_three(properties["link_data_three"]) {
+    }
+
+    bool
+    in_use() const {
+        return flags & 0x80;
+    }
+
+    bool
+    controller() const {
+        return flags & 0x40;
+    }
+
+    bool
+    high_water_mark() const {
+        return (flags & 0x02) == 0;
+    }
+
+    uint16_t memory_address;
+    uint8_t flags;
+    uint8_t group;
+    uint32_t link_address;
+    uint8_t data_one; // responder: on level
+    uint8_t data_two; // responder: ramp rate
+    uint8_t data_three;
+};
+
+} // namespace insteon
+} // namespace ace
+#endif /* INSTEONLINKRECORD_HPP */
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef INSTEONLINKTABLE_HPP
+#define INSTEONLINKTABLE_HPP
+
+#include "InsteonLinkRecord.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace ace {
+namespace insteon {
+
+/*
+ * InsteonLink
+ * 
+ * A controller to responder relationship for one group. The on level and
+ * ramp rate are only known when the responder's own record was read.
+ */
+struct InsteonLink {
+    uint32_t controller;
+    uint8_t group;
+    uint32_t responder;
+    uint8_t on_level;
+    uint8_t ramp_rate;
+    bool level_known;
+};
+
+/*
+ * InsteonLinkTable
+ * 
+ * The link graph of the network, built from the PLM database and the cached
+ * device ALDBs, indexed both as (controller, group) -> responders and as
+ * responder -> controllers. Like the device registry the indexes are
+ * published as an immutable snapshot, a lookup takes a brief global lock to
+ * load the snapshot and searches it without locking, updates rebuild the
+ * indexes under a mutex. Bulk loads stage every database and publish once.
+ */
+class InsteonLinkTable {
+public:
+    typedef std::vector<InsteonLink> links;
+
+    InsteonLinkTable();
+    InsteonLinkTable(const InsteonLinkTable& rhs) = delete;
+    InsteonLinkTable& operator=(const InsteonLinkTable& rhs) = delete;
+
+    void update(uint32_t owner, const std::vector<InsteonLinkRecord>& records);
+    void stage(uint32_t owner, const std::vector<InsteonLinkRecord>& records);
+    void publish();
+    links responders(uint32_t controller, uint8_t group) const;
+    links controllers(uint32_t responder) const;
+    std::size_t size() const;
+
+private:
+
+    struct index {
+        std::unordered_map<uint32_t, links> groups; // key(controller, group)
+        std::unordered_map<uint32_t, links> responders;
+        std::size_t size = 0;
+    };
+
+    static uint32_t key(uint32_t controller, uint8_t group) {
+        return (controller & 0xFFFFFF) << 8 | group;
+    }
+
+    static links collect(uint32_t owner,
+            const std::vector<InsteonLinkRecord>& records);
+    void rebuild();
+
+    std::shared_ptr<const index> index_; // accessed with atomic_load/store
+    std::mutex update_lock_; // serializes writers only
+    std::map<uint32_t, links> owners_; // links found in each database
+};
+
+} // namespace insteon
+} // namespace ace
+#endif /* INSTEONLINKTABLE_HPP */
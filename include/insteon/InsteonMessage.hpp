@@ -40,19 +40,22 @@ namespace ace {
         class InsteonMessage {
         public:
 
-            InsteonMessage() {
+            InsteonMessage() : origin_(0) {
             };
 
             InsteonMessage(uint32_t message_id, InsteonMessageType message_type,
                     PropertyKeys properties)
             : message_id_(message_id), message_type_(message_type), 
-            properties_(properties) {
+            properties_(properties), origin_(0) {
 
             };
             uint32_t message_id_;
             std::vector<uint8_t> raw_message;
             PropertyKeys properties_;
             InsteonMessageType message_type_;
+            // the external session whose raw command this echoes, 0 if the
+            // message isn't an echo of a raw command
+            uint32_t origin_;
         };
     } // namespace insteon
 } // namespace ace
@@ -29,11 +29,22 @@
 #define INSTEONNETWORK_HPP
 
 #include "InsteonDevice.hpp"
+#include "InsteonCommand.hpp"
+#include "InsteonDeviceRegistry.hpp"
+#include "InsteonLinkTable.hpp"
+#include "SceneEngine.hpp"
+#include "GroupProvisioner.hpp"
+#include "CommandQueue.hpp"
+#include "CommandSequence.hpp"
+#include "MessageProcessor.hpp"
 #include "../io/SerialPort.h"
 
 #include <memory>
+#include <mutex>
+#include <set>
 #include <condition_variable>
 #include <cstdint>
+#include <chrono>
 
 #include <boost/asio.hpp>
 
@@ -53,7 +64,8 @@ namespace ace {
             typedef InsteonNetwork type;
         public:
             InsteonNetwork() = delete;
-            InsteonNetwork(boost::asio::io_service& io_service, YAML::Node config);
+            InsteonNetwork(boost::asio::io_service& io_service,
+                    boost::asio::io_service& plm_io_service, YAML::Node config);
             ~InsteonNetwork();
 
             void
@@ -64,12 +76,29 @@ namespace ace {
             void loadDevices();
             void saveDevices();
             Json::Value serializeJson(uint32_t device_id = 0);
-            void internalReceiveCommand(std::string json);
-            void internalRawCommand(std::vector<uint8_t> buffer);
+            void internalReceiveCommand(InsteonCommand command);
+            void internalReceiveBatch(InsteonCommandBatch batch);
+            void internalRawCommand(uint32_t session_id,
+                    std::vector<uint8_t> buffer);
+            void provisionGroup(std::vector<uint32_t> devices, int group,
+                    std::string request_id, uint32_t session_id);
             void set_update_handler(
                     std::function<void(Json::Value json) > callback);
-            void set_houselinc_tx(
-                    std::function<void(std::vector<uint8_t> buffer) > callback);
+            void set_sync_progress_handler(
+                    std::function<void(Json::Value json) > callback);
+            void set_group_suggestion_handler(
+                    std::function<void(Json::Value json) > callback);
+            // session_id 0 relays to every session
+            void set_houselinc_tx(std::function<void(uint32_t session_id,
+                    const std::vector<uint8_t>& buffer) > callback);
+            void set_command_result_handler(
+                    std::function<void(uint32_t session_id, Json::Value json) >
+                    callback);
+            // every frame on the serial link, see MessageProcessor
+            void set_tap_handler(tap_handler callback);
+            // device work queued in the given lane, see CommandSequence
+            std::shared_ptr<CommandSequence> sequence(
+                    CommandPriority priority);
 
         protected:
             friend class InsteonController;
@@ -86,21 +115,98 @@ namespace ace {
 
             void onMessage(std::shared_ptr<InsteonMessage> im);
             void onUpdateDevice(Json::Value json);
-
-            std::mutex mx_load_db_;
-            std::condition_variable cv_load_db_;
+            void onDeviceALDB(uint32_t insteon_address,
+                    const InsteonDevice::LinkDatabase& aldb);
+            void pollDevice(uint32_t insteon_address,
+                    InsteonDeviceCommand command, uint8_t command_two);
+            void inferLinkedStatus(uint32_t controller,
+                    const std::shared_ptr<InsteonMessage>& im);
+
+            // a batch command resolved against its target device
+            struct ResolvedCommand {
+                std::shared_ptr<InsteonDevice> device;
+                InsteonDeviceCommand command;
+                uint8_t command_two;
+                std::string name; // the command as named by the client
+            };
+            typedef std::chrono::steady_clock::time_point time_point;
+            void executeCommand(ResolvedCommand command,
+                    InsteonCommand origin, time_point received);
+            void commandFinished(InsteonCommand origin, time_point received,
+                    InsteonCommandStatus status);
+            void executeBatch(std::vector<ResolvedCommand> commands,
+                    std::string request_id, uint32_t session_id,
+                    Json::Value results, time_point received);
+            void onCommandResult(uint32_t session_id, Json::Value json);
+            void executeScene(std::vector<ResolvedCommand> commands,
+                    std::string request_id, uint32_t session_id,
+                    Json::Value results, time_point received);
+            void onCleanupAck(uint32_t insteon_address, uint8_t command_one);
+
+            // PLM groups for devices commanded together
+            void suggestGroup(const GroupProvisioner::device_set& devices);
+            void executeProvision(std::vector<uint32_t> devices, int group,
+                    std::string request_id, uint32_t session_id);
+
+            // startup device sync, one device at a time through the Sync lane
+            void startDeviceSync();
+            void syncNext();
+            void syncDevice(std::shared_ptr<InsteonDevice> device);
+            void syncFinished(std::shared_ptr<InsteonDevice> device,
+                    InsteonCommandStatus status);
+            void syncProgress(uint32_t device_id, InsteonCommandStatus status);
+
+            // warm start snapshot of device state
+            void writeSnapshot();
+            void scheduleSnapshot();
         private:
             boost::asio::io_service& io_service_;
             boost::asio::io_service::strand io_strand_;
+            // PLM work, interactive commands preempt background sync
+            CommandQueue command_queue_;
             // pointer to Insteon Controller object
             std::unique_ptr<InsteonController> insteon_controller_;
-            // list of Insteon Devices
-            InsteonDeviceMap device_map_;
+            // Insteon Devices keyed by address
+            InsteonDeviceRegistry device_registry_;
+            // who controls whom, from the PLM database and device ALDBs
+            InsteonLinkTable link_table_;
+
+            // device polls waiting in the Sync lane, a poll is queued once
+            std::mutex poll_lock_;
+            std::set<uint64_t> poll_pending_;
+
+            // the group command in flight, responders that acked its cleanup
+            std::mutex scene_lock_;
+            bool scene_active_;
+            uint8_t scene_command_;
+            std::set<uint32_t> scene_acked_;
+
+            GroupProvisioner provisioner_;
             // pointer to message processor
             std::shared_ptr<MessageProcessor> msg_proc_;
             // pointer to callback function, executed when updates occur
             std::function<void(Json::Value) > on_update;
-            std::function<void(std::vector<uint8_t>) > houselinc_tx;
+            std::function<void(uint32_t, const std::vector<uint8_t>&) >
+            houselinc_tx;
+            std::function<void(uint32_t, Json::Value) > on_command_result;
+            std::function<void(Json::Value) > on_sync_progress;
+            std::function<void(Json::Value) > on_group_suggestion;
+
+            // startup sync state, only touched by the sync chain
+            boost::asio::steady_timer sync_timer_;
+            std::vector<std::shared_ptr<InsteonDevice>> sync_devices_;
+            std::size_t sync_index_;
+            std::size_t sync_completed_;
+            std::size_t sync_failed_;
+            std::size_t sync_skipped_;
+            std::chrono::milliseconds sync_interval_;
+            std::chrono::milliseconds sync_interval_min_;
+            std::chrono::milliseconds sync_interval_max_;
+            time_point sync_started_;
+
+            std::string snapshot_file_;
+            boost::asio::steady_timer snapshot_timer_;
+            std::mutex snapshot_lock_;
 
             YAML::Node config_;
         };
@@ -54,6 +54,8 @@ public:
         return true;
     }
 
+    static int32_t commandLength(uint8_t command, uint8_t message_flags = 0);
+
 private:
     bool standardMessage(const std::vector<uint8_t>& data, uint32_t offset,
                          uint32_t &count, std::shared_ptr<InsteonMessage>& insteon_message);
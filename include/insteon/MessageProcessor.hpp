@@ -29,6 +29,7 @@
 #define MESSENGER_HPP
 
 #include <vector>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -37,6 +38,7 @@
 
 
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include <yaml-cpp/yaml.h>
 
@@ -46,7 +48,6 @@
 #include "../io/ioport.hpp"
 #include "../io/SerialPort.h"
 #include "../io/SocketPort.h"
-#include "../system/AutoResetEvent.hpp"
 
 namespace ace
 {
@@ -54,19 +55,43 @@ namespace insteon
 {
 class InsteonMessage;
 
+typedef std::shared_ptr<InsteonMessage> msg_ptr;
+typedef std::function<void(msg_ptr) > msg_handler;
+
+/*
+ * WaitItem
+ * 
+ * A response expected from the IM. The handler is called exactly once, with
+ * the response or with nullptr when the wait is given up, it runs inline on
+ * the receiving thread and must not block or send.
+ */
 struct WaitItem {
 
-    WaitItem(uint8_t message_id) :
-    message_id_(message_id), message_received_(false) {
+    WaitItem(uint8_t message_id, uint32_t from_address, msg_handler handler)
+    : message_id_(message_id), from_address_(from_address),
+    completed_(false), on_complete_(handler) {
     }
     uint8_t message_id_;
-    bool message_received_;
-    system::AutoResetEvent wait_event_;
-    std::shared_ptr<InsteonMessage> insteon_message_;
+    uint32_t from_address_; // only a reply from this device, 0 for any
+    bool completed_; // guarded by the wait list mutex
+    msg_handler on_complete_;
+    std::unique_ptr<boost::asio::steady_timer> timer_; // async waits only
 };
 
-typedef std::shared_ptr<InsteonMessage> msg_ptr;
-typedef std::function<void(msg_ptr) > msg_handler;
+// the echo status and the properties of the response, empty on a timeout
+typedef std::function<void(PlmEcho status, PropertyKeys properties) >
+send_receive_handler;
+
+// which way a tapped frame crossed the serial link
+enum class TapDirection {
+    Tx, // host to IM, every attempt
+    Echo, // the IM echo of a command
+    Rx // an IM message
+};
+
+// receives every frame with its STX, decoded is null for Tx
+typedef std::function<void(TapDirection direction,
+        const std::vector<uint8_t>& raw, const msg_ptr& decoded) > tap_handler;
 
 /*
  * MessageProcessor class is responsible for coordinating
@@ -76,8 +101,9 @@ class MessageProcessor : private boost::noncopyable {
 public:
     typedef MessageProcessor type;
 
-    explicit MessageProcessor(boost::asio::io_service& io_service,
-                              YAML::Node config);
+    MessageProcessor(boost::asio::io_service& io_service,
+                     boost::asio::io_service& plm_io_service,
+                     YAML::Node config);
     ~MessageProcessor();
 
     bool connect(PropertyKeys& properties);
@@ -86,9 +112,20 @@ public:
                        bool retry_on_nak = true);
     PlmEcho trySend(const std::vector<uint8_t>& send_buffer,
                        bool retry_on_nak, uint32_t echo_length);
+    PlmEcho trySendNow(const std::vector<uint8_t>& send_buffer,
+                       bool retry_on_nak, uint32_t echo_length);
     PlmEcho trySendReceive(const std::vector<uint8_t>&
                               send_buffer, int8_t triesLeft, uint8_t receive_message_id,
                               PropertyKeys& properties);
+    PlmEcho trySendReceive(const std::vector<uint8_t>& send_buffer,
+                           int8_t triesLeft, uint8_t receive_message_id,
+                           PropertyKeys& properties,
+                           std::chrono::milliseconds timeout);
+    void asyncSendReceive(const std::vector<uint8_t>& send_buffer,
+                          int8_t tries_left, uint8_t receive_message_id,
+                          send_receive_handler handler);
+    void asyncSendRaw(const std::vector<uint8_t>& send_buffer,
+                      uint32_t origin, std::function<void() > done);
 
     /**
      * @param handler
@@ -97,6 +134,13 @@ public:
      * 
      */
     void set_message_handler(msg_handler handler);
+
+    /**
+     * @param handler
+     * The handler is invoked inline on the I/O path for every frame, it
+     * must only copy what it needs and return. Set it before connect.
+     */
+    void set_tap_handler(tap_handler handler);
 protected:
 private:
     void processData();
@@ -115,11 +159,23 @@ private:
     PlmEcho send(std::vector<uint8_t> send_buffer,
                     bool retry_on_nak, uint32_t echo_length);
     void updateWaitItems(const std::shared_ptr<InsteonMessage>& iMsg);
+    std::shared_ptr<WaitItem> addWaitItem(uint8_t message_id,
+                                          uint32_t from_address,
+                                          msg_handler handler);
+    bool completeWaitItem(const std::shared_ptr<WaitItem>& item,
+                          msg_ptr insteon_message);
+    bool removeWaitItem(const std::shared_ptr<WaitItem>& item);
+    static uint32_t responseAddress(const std::vector<uint8_t>& send_buffer);
+    void expireWaitItem(const std::shared_ptr<WaitItem>& item,
+                        std::chrono::milliseconds timeout);
 
     std::unique_ptr<io::IOPort> io_port_;
     boost::asio::io_service& io_service_;
+    // the port reads complete here, never behind blocked command work
+    boost::asio::io_service& plm_io_service_;
     boost::asio::io_service::strand io_strand_;
     msg_handler msg_handler_;
+    tap_handler tap_handler_;
     InsteonProtocol insteon_protocol_;
 
     std::list<std::shared_ptr<WaitItem>> wait_list_;
@@ -129,6 +185,7 @@ private:
     std::mutex lock_data_processor_;
 
     std::chrono::system_clock::time_point time_of_last_command_;
+    std::atomic<uint32_t> raw_origin_; // session of the raw command in flight
 
     YAML::Node config_;
     bool found_controller_;
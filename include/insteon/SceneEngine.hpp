@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef SCENEENGINE_HPP
+#define SCENEENGINE_HPP
+
+#include "InsteonDeviceCommands.hpp"
+#include "InsteonLinkTable.hpp"
+
+#include <vector>
+#include <cstdint>
+
+namespace ace {
+namespace insteon {
+
+// The state one device of a scene should end up in
+struct SceneTarget {
+    uint32_t device_id;
+    InsteonDeviceCommand command;
+    uint8_t command_two;
+};
+
+// A PLM group broadcast standing in for the commands of several targets
+struct SceneGroup {
+    uint8_t group;
+    InsteonDeviceCommand command;
+    uint8_t command_two;
+    std::vector<std::size_t> targets; // indexes into the scene targets
+};
+
+struct ScenePlan {
+    std::vector<SceneGroup> groups;
+    std::vector<std::size_t> direct; // targets left to direct commands
+};
+
+/*
+ * SceneEngine
+ * 
+ * Covers the targets of a scene with existing PLM groups. A group can only
+ * be used when every one of its responders is a target wanting the state
+ * the group command leaves it in, so that no other device is changed. On
+ * leaves each responder at the on level of its record, so On targets need
+ * the responder record and a matching level; Fast On, Off and Fast Off
+ * leave every responder in the same state. Larger groups are picked first,
+ * targets no group covers are sent direct commands.
+ */
+class SceneEngine {
+public:
+    static ScenePlan plan(const InsteonLinkTable& links, uint32_t plm_address,
+            const std::vector<SceneTarget>& targets);
+    // true if a group command of this kind exists
+    static bool groupable(InsteonDeviceCommand command);
+};
+
+} // namespace insteon
+} // namespace ace
+#endif /* SCENEENGINE_HPP */
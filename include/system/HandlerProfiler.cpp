@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "HandlerProfiler.hpp"
+#include "../Logger.h"
+
+#include <algorithm>
+#include <functional>
+#include <sstream>
+
+namespace ace
+{
+namespace system
+{
+
+namespace
+{
+
+uint64_t
+elapsedMicroseconds(std::chrono::steady_clock::time_point from,
+        std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            to - from).count();
+}
+
+std::string
+threadName(std::thread::id id) {
+    std::ostringstream oss;
+    oss << id;
+    return oss.str();
+}
+}
+
+HandlerProfiler::HandlerProfiler()
+: enabled_(false), slow_threshold_ms_(100), next_token_(0),
+watchdog_stop_(false) {
+}
+
+HandlerProfiler::~HandlerProfiler() {
+    Shutdown();
+}
+
+/**
+ * Configure
+ * 
+ * Turns tracking on or off and starts the watchdog, call it after the
+ * daemon forks since the watchdog is a thread.
+ * @param enabled record handlers posted from now on
+ * @param slow_threshold runs longer than this are logged, 0 disables the
+ * watchdog
+ */
+void
+HandlerProfiler::Configure(bool enabled,
+        std::chrono::milliseconds slow_threshold) {
+    Shutdown();
+    slow_threshold_ms_ = slow_threshold.count();
+    enabled_ = enabled;
+    if (!enabled || slow_threshold.count() <= 0)
+        return;
+    std::lock_guard<std::mutex>lock(lock_);
+    watchdog_stop_ = false;
+    watchdog_ = std::thread(std::bind(&type::Watchdog, this));
+}
+
+void
+HandlerProfiler::Shutdown() {
+    enabled_ = false;
+    {
+        std::lock_guard<std::mutex>lock(lock_);
+        watchdog_stop_ = true;
+    }
+    watchdog_cv_.notify_all();
+    if (watchdog_.joinable())
+        watchdog_.join();
+}
+
+void
+HandlerProfiler::Reset() {
+    std::lock_guard<std::mutex>lock(lock_);
+    stats_.clear();
+}
+
+uint64_t
+HandlerProfiler::Begin(const char* name,
+        std::chrono::steady_clock::time_point queued) {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t wait = elapsedMicroseconds(queued, now);
+    std::lock_guard<std::mutex>lock(lock_);
+    HandlerStats& stats = stats_[name];
+    if (stats.name.empty())
+        stats = HandlerStats{name, 0, 0, 0, 0, 0, 0};
+    stats.total_wait_us += wait;
+    stats.max_wait_us = std::max(stats.max_wait_us, wait);
+    uint64_t token = ++next_token_;
+    running_[token] = Running{name, now, std::this_thread::get_id(), false};
+    return token;
+}
+
+void
+HandlerProfiler::End(uint64_t token) {
+    auto now = std::chrono::steady_clock::now();
+    Running running;
+    uint64_t exec = 0;
+    bool slow = false;
+    {
+        std::lock_guard<std::mutex>lock(lock_);
+        auto it = running_.find(token);
+        if (it == running_.end())
+            return;
+        running = it->second;
+        running_.erase(it);
+        exec = elapsedMicroseconds(running.started, now);
+        HandlerStats& stats = stats_[running.name];
+        stats.name = running.name; // Reset may have dropped it since Begin
+        stats.count++;
+        stats.total_exec_us += exec;
+        stats.max_exec_us = std::max(stats.max_exec_us, exec);
+        int64_t threshold = slow_threshold_ms_;
+        slow = threshold > 0 && exec > uint64_t(threshold) * 1000;
+        if (slow)
+            stats.slow++;
+    }
+    // logged unlocked, a slow log write must not hold up other handlers
+    if (slow)
+        utils::Logger::Instance().Warning("%s\n\t  - %s %s %llu ms",
+            FUNCTION_NAME_CSTR, running.name, running.reported ?
+            "finished after" : "took", (unsigned long long) (exec / 1000));
+}
+
+/**
+ * Top
+ * 
+ * @param count number of handler types to return, 0 for all
+ * @return handler types by total execution time, worst first
+ */
+std::vector<HandlerStats>
+HandlerProfiler::Top(std::size_t count) const {
+    std::vector<HandlerStats> top;
+    {
+        std::lock_guard<std::mutex>lock(lock_);
+        for (const auto& it : stats_)
+            top.push_back(it.second);
+    }
+    std::sort(top.begin(), top.end(), [](const HandlerStats& a,
+            const HandlerStats & b) {
+        return a.total_exec_us > b.total_exec_us;
+    });
+    if (count && top.size() > count)
+        top.resize(count);
+    return top;
+}
+
+/**
+ * Watchdog
+ * 
+ * Wakes at half the threshold and reports each handler that has been
+ * running longer than the threshold once, naming the thread it holds.
+ */
+void
+HandlerProfiler::Watchdog() {
+    std::unique_lock<std::mutex>lock(lock_);
+    while (!watchdog_stop_) {
+        std::chrono::milliseconds threshold(slow_threshold_ms_.load());
+        watchdog_cv_.wait_for(lock, std::max(threshold / 2,
+                std::chrono::milliseconds(10)));
+        if (watchdog_stop_)
+            break;
+        auto now = std::chrono::steady_clock::now();
+        std::vector<Running> blocked;
+        for (auto& it : running_) {
+            if (it.second.reported || now - it.second.started < threshold)
+                continue;
+            it.second.reported = true;
+            blocked.push_back(it.second);
+        }
+        if (blocked.empty())
+            continue;
+        // Begin and End of every pool wait on lock_, never log holding it
+        lock.unlock();
+        for (const auto& it : blocked) {
+            utils::Logger::Instance().Warning("%s\n\t  - %s blocked thread %s "
+                    "for %lld ms and counting", FUNCTION_NAME_CSTR, it.name,
+                    threadName(it.thread).c_str(), (long long)
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                    now - it.started).count());
+        }
+        lock.lock();
+    }
+}
+}
+}
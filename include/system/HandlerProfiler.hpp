@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef HANDLERPROFILER_HPP
+#define	HANDLERPROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ace {
+    namespace system {
+
+        struct HandlerStats {
+            std::string name;
+            uint64_t count;
+            uint64_t total_wait_us; // posted until a thread ran it
+            uint64_t max_wait_us;
+            uint64_t total_exec_us;
+            uint64_t max_exec_us;
+            uint64_t slow; // runs over the slow handler threshold
+        };
+
+        /*
+         * HandlerProfiler
+         * 
+         * Optional per handler type queue wait and execution times. Handlers
+         * are tagged with profile() where they are posted, while disabled a
+         * tagged handler costs one atomic load. A watchdog thread logs any
+         * handler still running past the threshold, so a blocked thread is
+         * reported while it is blocked rather than after.
+         */
+        class HandlerProfiler {
+            typedef HandlerProfiler type;
+        public:
+
+            static HandlerProfiler&
+            Instance() {
+                static HandlerProfiler instance;
+                return instance;
+            }
+
+            void Configure(bool enabled,
+                    std::chrono::milliseconds slow_threshold);
+            void Shutdown();
+            void Reset();
+
+            bool
+            Enabled() const {
+                return enabled_.load(std::memory_order_relaxed);
+            }
+
+            std::chrono::milliseconds
+            SlowThreshold() const {
+                return std::chrono::milliseconds(slow_threshold_ms_.load());
+            }
+            uint64_t Begin(const char* name,
+                    std::chrono::steady_clock::time_point queued);
+            void End(uint64_t token);
+            std::vector<HandlerStats> Top(std::size_t count) const;
+        private:
+            HandlerProfiler();
+            ~HandlerProfiler();
+            HandlerProfiler(const HandlerProfiler&) = delete;
+            HandlerProfiler& operator=(const HandlerProfiler&) = delete;
+            void Watchdog();
+
+            struct Running {
+                const char* name;
+                std::chrono::steady_clock::time_point started;
+                std::thread::id thread;
+                bool reported; // already logged by the watchdog
+            };
+
+            std::atomic<bool> enabled_;
+            std::atomic<int64_t> slow_threshold_ms_;
+            mutable std::mutex lock_;
+            std::map<std::string, HandlerStats> stats_;
+            std::map<uint64_t, Running> running_;
+            uint64_t next_token_;
+
+            std::thread watchdog_;
+            std::condition_variable watchdog_cv_;
+            bool watchdog_stop_;
+        };
+
+        /*
+         * ProfiledHandler
+         * 
+         * Records the time it was created, which is when it was posted, and
+         * reports the wait and the run of the wrapped handler.
+         */
+        template<typename Handler>
+        class ProfiledHandler {
+        public:
+
+            ProfiledHandler(const char* name, Handler handler)
+            : name_(name), handler_(std::move(handler)) {
+                if (HandlerProfiler::Instance().Enabled())
+                    queued_ = std::chrono::steady_clock::now();
+            }
+
+            template<typename... Args>
+            void operator()(Args&&... args) {
+                if (queued_ == std::chrono::steady_clock::time_point()) {
+                    handler_(std::forward<Args>(args)...);
+                    return;
+                }
+                Scope scope(HandlerProfiler::Instance().Begin(name_,
+                        queued_));
+                handler_(std::forward<Args>(args)...);
+            }
+        private:
+
+            struct Scope {
+
+                explicit Scope(uint64_t token) : token_(token) {
+                }
+
+                ~Scope() {
+                    HandlerProfiler::Instance().End(token_);
+                }
+                uint64_t token_;
+            };
+
+            const char* name_;
+            Handler handler_;
+            std::chrono::steady_clock::time_point queued_;
+        };
+
+        /**
+         * profile
+         * 
+         * Tags a handler before it is posted, eg:
+         *   io_strand_.post(system::profile("InsteonDevice::command", ...));
+         * @param name a string literal naming the handler type
+         * @param handler the handler to run
+         */
+        template<typename Handler>
+        ProfiledHandler<Handler>
+        profile(const char* name, Handler handler) {
+            return ProfiledHandler<Handler>(name, std::move(handler));
+        }
+    }
+}
+
+#endif	/* HANDLERPROFILER_HPP */
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "ThreadPool.hpp"
+#include "../Logger.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ace
+{
+namespace system
+{
+
+namespace
+{
+const std::chrono::seconds kProbeInterval(1);
+}
+
+ThreadPool::ThreadPool(const std::string& name, std::size_t threads,
+        const std::vector<int>& cpus)
+: name_(name), thread_count_(std::max<std::size_t>(1, threads)), cpus_(cpus),
+work_(new boost::asio::io_service::work(io_service_)),
+probe_strand_(io_service_), probe_timer_(io_service_), probing_(false),
+posted_(0), executed_(0), latency_us_(0), max_latency_us_(0) {
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+    join();
+}
+
+void
+ThreadPool::notify_fork(boost::asio::io_service::fork_event event) {
+    io_service_.notify_fork(event);
+}
+
+void
+ThreadPool::start() {
+    if (!threads_.empty())
+        return;
+    probing_ = true;
+    probe();
+    for (std::size_t i = 0; i < thread_count_; ++i) {
+        threads_.emplace_back(std::bind(&type::run, this, i));
+    }
+    utils::Logger::Instance().Info("%s\n\t  - %s pool running on %zu threads",
+            FUNCTION_NAME_CSTR, name_.c_str(), thread_count_);
+}
+
+// returns at once, safe from a pool thread
+
+void
+ThreadPool::stop() {
+    work_.reset();
+    io_service_.stop();
+}
+
+/**
+ * release
+ * 
+ * Lets the threads exit once the queued work is done, unlike stop nothing
+ * already posted is abandoned.
+ */
+void
+ThreadPool::release() {
+    work_.reset();
+    probe_strand_.post([this]() {
+        probing_ = false;
+        probe_timer_.cancel();
+    });
+}
+
+// must not be called from a pool thread
+
+void
+ThreadPool::join() {
+    for (auto& it : threads_) {
+        if (it.joinable() && it.get_id() != std::this_thread::get_id())
+            it.join();
+    }
+    threads_.clear();
+}
+
+ThreadPoolStats
+ThreadPool::stats() const {
+    ThreadPoolStats stats;
+    stats.name = name_;
+    stats.threads = thread_count_;
+    stats.posted = posted_;
+    stats.executed = executed_;
+    stats.latency_us = latency_us_;
+    stats.max_latency_us = max_latency_us_;
+    return stats;
+}
+
+void
+ThreadPool::run(std::size_t index) {
+#ifdef __linux__
+    if (!cpus_.empty()) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (int cpu : cpus_)
+            CPU_SET(cpu, &cpu_set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof (cpu_set),
+                &cpu_set);
+        if (rc != 0)
+            utils::Logger::Instance().Warning("%s\n\t  - unable to pin %s "
+                "thread %zu: %d", FUNCTION_NAME_CSTR, name_.c_str(), index, rc);
+    }
+    // the kernel limits thread names to 15 characters
+    std::string thread_name = name_.substr(0, 12) + std::to_string(index);
+    pthread_setname_np(pthread_self(), thread_name.substr(0, 15).c_str());
+#endif
+    try {
+        io_service_.run();
+    } catch (std::exception& e) {
+        utils::Logger::Instance().Warning("%s\n\t  - %s thread %zu: %s",
+                FUNCTION_NAME_CSTR, name_.c_str(), index, e.what());
+    }
+}
+
+/**
+ * probe
+ * 
+ * Posts a handler once a second and records how long it waited before a
+ * thread ran it, the latency stays near zero until the pool is saturated.
+ */
+void
+ThreadPool::probe() {
+    if (!probing_)
+        return;
+    probe_timer_.expires_from_now(kProbeInterval);
+    probe_timer_.async_wait(probe_strand_.wrap([this](
+            const boost::system::error_code & ec) {
+        if (ec || !probing_)
+            return;
+        auto queued = std::chrono::steady_clock::now();
+        io_service_.post([this, queued]() {
+            uint64_t latency = std::chrono::duration_cast<
+                    std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - queued).count();
+            latency_us_ = latency;
+            uint64_t max = max_latency_us_;
+            while (latency > max &&
+                    !max_latency_us_.compare_exchange_weak(max, latency)) {
+            }
+        });
+        probe();
+    }));
+}
+}
+}
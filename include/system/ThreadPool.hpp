@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2012, Aaron Coombs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Autohub++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AARON COOMBS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THREADPOOL_HPP
+#define	THREADPOOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+
+#include "HandlerProfiler.hpp"
+
+namespace ace {
+    namespace system {
+
+        struct ThreadPoolStats {
+            std::string name;
+            std::size_t threads;
+            uint64_t posted; // handlers posted through the pool
+            uint64_t executed;
+            uint64_t latency_us; // last probe, post to run
+            uint64_t max_latency_us;
+        };
+
+        /*
+         * ThreadPool
+         * 
+         * A fixed number of named threads running one io_service, optionally
+         * pinned to a set of CPUs. The threads are started separately from
+         * the constructor so the pool can be built before the daemon forks.
+         * A probe handler is posted once a second to measure how long work
+         * waits for a free thread.
+         */
+        class ThreadPool {
+            typedef ThreadPool type;
+        public:
+            ThreadPool() = delete;
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+            ThreadPool(const std::string& name, std::size_t threads,
+                    const std::vector<int>& cpus = std::vector<int>());
+            ~ThreadPool();
+
+            boost::asio::io_service& io_service() {
+                return io_service_;
+            }
+            void notify_fork(boost::asio::io_service::fork_event event);
+            void start();
+            void stop();
+            void release();
+            void join();
+            ThreadPoolStats stats() const;
+
+            template<typename Handler>
+            void post(Handler handler) {
+                posted_++;
+                io_service_.post([this, handler]() mutable {
+                    handler();
+                    executed_++;
+                });
+            }
+
+            // tagged for the HandlerProfiler
+            template<typename Handler>
+            void post(const char* name, Handler handler) {
+                post(profile(name, std::move(handler)));
+            }
+        private:
+            void run(std::size_t index);
+            void probe();
+
+            std::string name_;
+            std::size_t thread_count_;
+            std::vector<int> cpus_;
+            boost::asio::io_service io_service_;
+            std::unique_ptr<boost::asio::io_service::work> work_;
+            std::vector<std::thread> threads_;
+
+            // the probe timer is only touched on its strand
+            boost::asio::io_service::strand probe_strand_;
+            boost::asio::steady_timer probe_timer_;
+            bool probing_;
+
+            std::atomic<uint64_t> posted_;
+            std::atomic<uint64_t> executed_;
+            std::atomic<uint64_t> latency_us_;
+            std::atomic<uint64_t> max_latency_us_;
+        };
+    }
+}
+
+#endif	/* THREADPOOL_HPP */
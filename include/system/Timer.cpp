@@ -32,90 +32,59 @@ namespace system
 {
 
 Timer::Timer(boost::asio::io_service& io_service)
-: io_service_(io_service), interval_milliseconds_(0),
-is_running_(false), timer_active_(false), timer_event_(false) {
+: state_(std::make_shared<State>(io_service)) {
 }
 
 Timer::~Timer() {
-    if (is_running_) {
-        Shutdown();
-    }
-    if (thread_.joinable()) {
-        thread_.join();
-    }
+    Stop();
 }
 
 void
-Timer::OnTimer() {
-    _timerCallback();
-}
-
-bool
-Timer::Run() {
-    if (!_timerCallback || !is_running_) return false;
-    while (is_running_) {
-        std::unique_lock<std::mutex>lock(timer_mutex_);
-        if (timer_active_) {
-            if (!timer_cv_.wait_for(lock,
-                    std::chrono::milliseconds(interval_milliseconds_),
-                    [this]() {
-                        return timer_event_ == true;
-                    })) {
-            {
-                std::lock_guard<std::mutex>lock(lock_);
-                timer_active_ = false;
-            }
-            std::thread t(&type::OnTimer, this);
-            t.detach();
-            //io_service_.post(std::bind(&type::OnTimer, this));
-        } else { // timer_event_ = true
-                timer_event_ = false; // reset event
-            }
-        } else { // wait indefinitely or there's an event
-            timer_cv_.wait(lock, [this]() {
-                return timer_event_ == true;
-            });
-            timer_event_ = false; // reset event
-        }
-    }
-}
-
-bool
-Timer::RunAsync() {
-    if (!_timerCallback || is_running_) return false;
-    is_running_ = true;
-    std::thread process_thread(std::bind(&Timer::Run, this));
-    thread_ = std::move(process_thread);
-    return true;
+Timer::SetTimerCallback(std::function<void()> callback) {
+    std::lock_guard<std::mutex>lock(state_->lock_);
+    state_->callback_ = callback;
 }
 
+/**
+ * OnTimer
+ * 
+ * A wait that was cancelled, or superseded before the cancel reached it,
+ * no longer matches the generation and is dropped.
+ */
 void
-Timer::Shutdown() {
-    is_running_ = false;
-    Stop();
+Timer::OnTimer(std::shared_ptr<State> state, uint64_t generation) {
+    std::function<void()> callback;
+    {
+        std::lock_guard<std::mutex>lock(state->lock_);
+        if (generation != state->generation_)
+            return;
+        state->generation_++; // one shot
+        callback = state->callback_;
+    }
+    if (callback)
+        callback();
 }
 
 // Stops the timer
 
 void
 Timer::Stop() {
-    {
-        std::lock_guard<std::mutex>lock(lock_);
-        timer_active_ = false;
-        timer_event_ = true;
-    }
-    timer_cv_.notify_all();
+    std::lock_guard<std::mutex>lock(state_->lock_);
+    state_->generation_++;
+    state_->timer_.cancel();
 }
 
 void
 Timer::Reset(uint32_t milliseconds) {
-    {
-        std::lock_guard<std::mutex>lock(lock_);
-        timer_event_ = true;
-        interval_milliseconds_ = milliseconds;
-        timer_active_ = true;
-    }
-    timer_cv_.notify_all();
+    std::lock_guard<std::mutex>lock(state_->lock_);
+    uint64_t generation = ++state_->generation_;
+    state_->timer_.expires_from_now(std::chrono::milliseconds(milliseconds));
+    std::shared_ptr<State> state = state_;
+    state_->timer_.async_wait([state, generation](
+            const boost::system::error_code& ec) {
+        if (!ec)
+            OnTimer(state, generation);
+    });
 }
 }
 }
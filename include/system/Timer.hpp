@@ -29,44 +29,50 @@
 #define	TIMER_H
 
 #include <functional>
-#include <thread>
+#include <memory>
 #include <mutex>
-#include <condition_variable>
+#include <cstdint>
 
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 namespace ace {
     namespace system {
-        
+
+        /*
+         * Timer
+         * 
+         * A one shot timer on the io_service timer queue, no thread is
+         * owned or started. Reset re-arms it and Stop disarms it, both are
+         * safe from any thread including the callback. The callback runs on
+         * an io_service thread and never after Stop or the destructor.
+         */
         class Timer {
             typedef Timer type;
         public:
             Timer() = delete;
-            Timer(boost::asio::io_service& io_service);
+            explicit Timer(boost::asio::io_service& io_service);
             ~Timer();
-            
-            bool Run();
-            bool RunAsync();
 
-            void SetTimerCallback(std::function<void()> callback){
-                _timerCallback = callback;
-            }
+            void SetTimerCallback(std::function<void()> callback);
             void Stop();
             void Reset(uint32_t milliseconds);
-            void Shutdown();
         private:
-            void OnTimer();
-            int interval_milliseconds_;
-            std::thread thread_;
-            std::mutex lock_;
-            bool is_running_;
-            bool timer_active_;
-            
-            std::condition_variable timer_cv_;
-            bool timer_event_;
-            std::mutex timer_mutex_;
-            std::function<void()> _timerCallback;
-            boost::asio::io_service& io_service_;
+            // outlives the Timer while a wait is queued
+            struct State {
+
+                explicit State(boost::asio::io_service& io_service)
+                : timer_(io_service), generation_(0) {
+                }
+                std::mutex lock_;
+                boost::asio::steady_timer timer_;
+                uint64_t generation_; // bumped by Reset and Stop
+                std::function<void()> callback_;
+            };
+
+            static void OnTimer(std::shared_ptr<State> state,
+                    uint64_t generation);
+            std::shared_ptr<State> state_;
         };
     }
 }
@@ -29,6 +29,7 @@
 #include "include/insteon/InsteonNetwork.hpp"
 #include "include/Logger.h"
 #include "include/config.hpp"
+#include "include/system/ThreadPool.hpp"
 
 #include <cstdlib>
 #include <iostream>
@@ -39,7 +40,6 @@
 #include <syslog.h>
 #include <unistd.h>
 
-#include <boost/thread/thread.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/signal_set.hpp>
 
@@ -91,18 +91,35 @@ int main(int argc, char** argv) {
                 BOOST_VERSION / 100000, (BOOST_VERSION / 100) % 1000,
                 BOOST_VERSION % 100);
 
-        boost::asio::io_service io_service;
-        boost::thread_group threadpool;
-        boost::asio::io_service::work work(io_service);
+        YAML::Node threads = config["THREADS"];
+        std::size_t dispatch_threads = threads["dispatch"].as<std::size_t>(2);
+        if (config["worker_threads"] && !threads["dispatch"]) {
+            dispatch_threads = config["worker_threads"].as<std::size_t>(2);
+            ace::utils::Logger::Instance().Warning("worker_threads is "
+                    "deprecated, set THREADS dispatch instead");
+        }
+
+        // commands, timers and the TCP servers, the blocking batch and scene
+        // jobs hold at most one of these threads since they run on a strand
+        ace::system::ThreadPool dispatch_pool("dispatch", dispatch_threads,
+                threads["dispatch_affinity"].as<std::vector<int>>(
+                std::vector<int>()));
+        // PLM port reads, the second thread completes a read while the
+        // receive handler waits for the rest of a partial frame
+        ace::system::ThreadPool plm_pool("plm", 2,
+                threads["plm_affinity"].as<std::vector<int>>(
+                std::vector<int>()));
+        boost::asio::io_service& io_service = dispatch_pool.io_service();
 
-        ace::Autohub autohub(io_service, config);
+        ace::Autohub autohub(dispatch_pool, plm_pool, config);
 
         boost::asio::signal_set sig_set(io_service, SIGTERM, SIGINT);
-        sig_set.async_wait(std::bind([&io_service, &autohub]() {
+        sig_set.async_wait(std::bind([&dispatch_pool, &autohub]() {
             autohub.stop();
-            io_service.stop();
+            dispatch_pool.stop();
         }));
-        io_service.notify_fork(boost::asio::io_service::fork_prepare);
+        dispatch_pool.notify_fork(boost::asio::io_service::fork_prepare);
+        plm_pool.notify_fork(boost::asio::io_service::fork_prepare);
         
         // close all descriptors
         for (int i = getdtablesize(); i >=0; --i)
@@ -178,24 +195,21 @@ int main(int argc, char** argv) {
         // Inform the io_service that we have finished becoming a daemon. The
         // io_service uses this opportunity to create any internal file descriptors
         // that need to be private to the new process.
-        io_service.notify_fork(boost::asio::io_service::fork_child);
+        dispatch_pool.notify_fork(boost::asio::io_service::fork_child);
+        plm_pool.notify_fork(boost::asio::io_service::fork_child);
 
         // The io_service can now be used normally.
         syslog(LOG_INFO | LOG_USER, "autohubpp Daemon started");
 
-        uint32_t worker_threads = config["worker_threads"].as<int>(50);
-
-        for (int c = 0; c < worker_threads; ++c) {
-            ace::utils::Logger::Instance().Debug("Starting Thread: %d", (c + 1));
-            threadpool.create_thread([&io_service]() {
-                io_service.run();
-            });
-        }
+        dispatch_pool.start();
+        plm_pool.start();
 
         bool fRet = false;
         fRet = autohub.start();
 
-        threadpool.join_all();
+        dispatch_pool.join();
+        plm_pool.stop();
+        plm_pool.join();
 
         std::ofstream ofs(config_file_);
         ofs << config;
@@ -37,17 +37,27 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 OBJECTFILES= \
 	${OBJECTDIR}/AutoResetEvent.o \
 	${OBJECTDIR}/Autohub.o \
+	${OBJECTDIR}/CommandQueue.o \
+	${OBJECTDIR}/CommandSequence.o \
+	${OBJECTDIR}/DeviceSnapshot.o \
 	${OBJECTDIR}/DynamicLibrary.o \
+	${OBJECTDIR}/GroupProvisioner.o \
 	${OBJECTDIR}/InsteonController.o \
 	${OBJECTDIR}/InsteonDevice.o \
+	${OBJECTDIR}/InsteonDeviceRegistry.o \
+	${OBJECTDIR}/InsteonDeviceState.o \
+	${OBJECTDIR}/InsteonLinkTable.o \
 	${OBJECTDIR}/InsteonNetwork.o \
 	${OBJECTDIR}/InsteonProtocol.o \
 	${OBJECTDIR}/Logger.o \
 	${OBJECTDIR}/MessageProcessor.o \
+	${OBJECTDIR}/SceneEngine.o \
 	${OBJECTDIR}/SerialPort.o \
 	${OBJECTDIR}/SocketPort.o \
 	${OBJECTDIR}/autoapi.o \
 	${OBJECTDIR}/config.o \
+	${OBJECTDIR}/include/system/HandlerProfiler.o \
+	${OBJECTDIR}/include/system/ThreadPool.o \
 	${OBJECTDIR}/include/system/Timer.o \
 	${OBJECTDIR}/include/utils/utils.o \
 	${OBJECTDIR}/jsoncpp.o \
@@ -88,11 +98,31 @@ ${OBJECTDIR}/Autohub.o: nbproject/Makefile-${CND_CONF}.mk Autohub.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Autohub.o Autohub.cpp
 
+${OBJECTDIR}/CommandQueue.o: nbproject/Makefile-${CND_CONF}.mk CommandQueue.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/CommandQueue.o CommandQueue.cpp
+
+${OBJECTDIR}/CommandSequence.o: nbproject/Makefile-${CND_CONF}.mk CommandSequence.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/CommandSequence.o CommandSequence.cpp
+
+${OBJECTDIR}/DeviceSnapshot.o: nbproject/Makefile-${CND_CONF}.mk DeviceSnapshot.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/DeviceSnapshot.o DeviceSnapshot.cpp
+
 ${OBJECTDIR}/DynamicLibrary.o: nbproject/Makefile-${CND_CONF}.mk DynamicLibrary.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/DynamicLibrary.o DynamicLibrary.cpp
 
+${OBJECTDIR}/GroupProvisioner.o: nbproject/Makefile-${CND_CONF}.mk GroupProvisioner.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/GroupProvisioner.o GroupProvisioner.cpp
+
 ${OBJECTDIR}/InsteonController.o: nbproject/Makefile-${CND_CONF}.mk InsteonController.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -103,6 +133,21 @@ ${OBJECTDIR}/InsteonDevice.o: nbproject/Makefile-${CND_CONF}.mk InsteonDevice.cp
 	${RM} "$@.d"
 	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/InsteonDevice.o InsteonDevice.cpp
 
+${OBJECTDIR}/InsteonDeviceRegistry.o: nbproject/Makefile-${CND_CONF}.mk InsteonDeviceRegistry.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/InsteonDeviceRegistry.o InsteonDeviceRegistry.cpp
+
+${OBJECTDIR}/InsteonDeviceState.o: nbproject/Makefile-${CND_CONF}.mk InsteonDeviceState.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/InsteonDeviceState.o InsteonDeviceState.cpp
+
+${OBJECTDIR}/InsteonLinkTable.o: nbproject/Makefile-${CND_CONF}.mk InsteonLinkTable.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/InsteonLinkTable.o InsteonLinkTable.cpp
+
 ${OBJECTDIR}/InsteonNetwork.o: nbproject/Makefile-${CND_CONF}.mk InsteonNetwork.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -123,6 +168,11 @@ ${OBJECTDIR}/MessageProcessor.o: nbproject/Makefile-${CND_CONF}.mk MessageProces
 	${RM} "$@.d"
 	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/MessageProcessor.o MessageProcessor.cpp
 
+${OBJECTDIR}/SceneEngine.o: nbproject/Makefile-${CND_CONF}.mk SceneEngine.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SceneEngine.o SceneEngine.cpp
+
 ${OBJECTDIR}/SerialPort.o: nbproject/Makefile-${CND_CONF}.mk SerialPort.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -143,6 +193,16 @@ ${OBJECTDIR}/config.o: nbproject/Makefile-${CND_CONF}.mk config.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/config.o config.cpp
 
+${OBJECTDIR}/include/system/HandlerProfiler.o: nbproject/Makefile-${CND_CONF}.mk include/system/HandlerProfiler.cpp 
+	${MKDIR} -p ${OBJECTDIR}/include/system
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/include/system/HandlerProfiler.o include/system/HandlerProfiler.cpp
+
+${OBJECTDIR}/include/system/ThreadPool.o: nbproject/Makefile-${CND_CONF}.mk include/system/ThreadPool.cpp 
+	${MKDIR} -p ${OBJECTDIR}/include/system
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -DBOOST_FILESYSTEM_NO_DEPRECATED -DBOOST_LOG_DYN_LINK -I/usr/include/websocketpp -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/include/system/ThreadPool.o include/system/ThreadPool.cpp
+
 ${OBJECTDIR}/include/system/Timer.o: nbproject/Makefile-${CND_CONF}.mk include/system/Timer.cpp 
 	${MKDIR} -p ${OBJECTDIR}/include/system
 	${RM} "$@.d"
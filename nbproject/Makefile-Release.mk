@@ -37,17 +37,27 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 OBJECTFILES= \
 	${OBJECTDIR}/AutoResetEvent.o \
 	${OBJECTDIR}/Autohub.o \
+	${OBJECTDIR}/CommandQueue.o \
+	${OBJECTDIR}/CommandSequence.o \
+	${OBJECTDIR}/DeviceSnapshot.o \
 	${OBJECTDIR}/DynamicLibrary.o \
+	${OBJECTDIR}/GroupProvisioner.o \
 	${OBJECTDIR}/InsteonController.o \
 	${OBJECTDIR}/InsteonDevice.o \
+	${OBJECTDIR}/InsteonDeviceRegistry.o \
+	${OBJECTDIR}/InsteonDeviceState.o \
+	${OBJECTDIR}/InsteonLinkTable.o \
 	${OBJECTDIR}/InsteonNetwork.o \
 	${OBJECTDIR}/InsteonProtocol.o \
 	${OBJECTDIR}/Logger.o \
 	${OBJECTDIR}/MessageProcessor.o \
+	${OBJECTDIR}/SceneEngine.o \
 	${OBJECTDIR}/SerialPort.o \
 	${OBJECTDIR}/SocketPort.o \
 	${OBJECTDIR}/autoapi.o \
 	${OBJECTDIR}/config.o \
+	${OBJECTDIR}/include/system/HandlerProfiler.o \
+	${OBJECTDIR}/include/system/ThreadPool.o \
 	${OBJECTDIR}/include/system/Timer.o \
 	${OBJECTDIR}/include/utils/utils.o \
 	${OBJECTDIR}/jsoncpp.o \
@@ -88,11 +98,31 @@ ${OBJECTDIR}/Autohub.o: Autohub.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Autohub.o Autohub.cpp
 
+${OBJECTDIR}/CommandQueue.o: CommandQueue.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/CommandQueue.o CommandQueue.cpp
+
+${OBJECTDIR}/CommandSequence.o: CommandSequence.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/CommandSequence.o CommandSequence.cpp
+
+${OBJECTDIR}/DeviceSnapshot.o: DeviceSnapshot.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/DeviceSnapshot.o DeviceSnapshot.cpp
+
 ${OBJECTDIR}/DynamicLibrary.o: DynamicLibrary.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/DynamicLibrary.o DynamicLibrary.cpp
 
+${OBJECTDIR}/GroupProvisioner.o: GroupProvisioner.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/GroupProvisioner.o GroupProvisioner.cpp
+
 ${OBJECTDIR}/InsteonController.o: InsteonController.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -103,6 +133,21 @@ ${OBJECTDIR}/InsteonDevice.o: InsteonDevice.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/InsteonDevice.o InsteonDevice.cpp
 
+${OBJECTDIR}/InsteonDeviceRegistry.o: InsteonDeviceRegistry.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/InsteonDeviceRegistry.o InsteonDeviceRegistry.cpp
+
+${OBJECTDIR}/InsteonDeviceState.o: InsteonDeviceState.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/InsteonDeviceState.o InsteonDeviceState.cpp
+
+${OBJECTDIR}/InsteonLinkTable.o: InsteonLinkTable.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/InsteonLinkTable.o InsteonLinkTable.cpp
+
 ${OBJECTDIR}/InsteonNetwork.o: InsteonNetwork.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -123,6 +168,11 @@ ${OBJECTDIR}/MessageProcessor.o: MessageProcessor.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/MessageProcessor.o MessageProcessor.cpp
 
+${OBJECTDIR}/SceneEngine.o: SceneEngine.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SceneEngine.o SceneEngine.cpp
+
 ${OBJECTDIR}/SerialPort.o: SerialPort.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -143,6 +193,16 @@ ${OBJECTDIR}/config.o: config.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/config.o config.cpp
 
+${OBJECTDIR}/include/system/HandlerProfiler.o: include/system/HandlerProfiler.cpp 
+	${MKDIR} -p ${OBJECTDIR}/include/system
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/include/system/HandlerProfiler.o include/system/HandlerProfiler.cpp
+
+${OBJECTDIR}/include/system/ThreadPool.o: include/system/ThreadPool.cpp 
+	${MKDIR} -p ${OBJECTDIR}/include/system
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/include/system/ThreadPool.o include/system/ThreadPool.cpp
+
 ${OBJECTDIR}/include/system/Timer.o: include/system/Timer.cpp 
 	${MKDIR} -p ${OBJECTDIR}/include/system
 	${RM} "$@.d"